@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "co.h"
+#include "bench.h"
+
+// 模拟请求处理: 每个请求协程做一批小分配, 中间让出几次, 结束时全部释放
+//   malloc: 每个对象 malloc, 请求结束时逐个 free
+//   co_alloc: 只移动指针, 协程结束时整块归还
+//   ./bench-alloc [THREADS]    默认 1, 每个线程各自跑一遍
+
+#define REQUESTS 20000 // 每个线程
+#define CONCURRENT 100 // 同时存活的请求协程
+#define ALLOCS 64      // 每个请求的分配次数
+#define YIELDS 4
+
+enum mode { MODE_NONE, MODE_MALLOC, MODE_CO_ALLOC };
+
+static const char *mode_names[] = { "none", "malloc", "co_alloc" };
+
+// 多数是几十到几百字节, 少数是几 KB 的缓冲区
+static size_t request_size(unsigned int *seed) {
+    unsigned int r = rand_r(seed);
+    return r % 16 == 0 ? 1024 + r % 4096 : 16 + r % 256;
+}
+
+struct request {
+    enum mode mode;
+    unsigned int seed;
+};
+
+static void handle(void *arg) {
+    struct request *req = (struct request *)arg;
+    void *objs[ALLOCS];
+    for (int i = 0; i < ALLOCS; i++) {
+        size_t size = request_size(&req->seed);
+        if (req->mode == MODE_MALLOC) {
+            objs[i] = malloc(size);
+        } else if (req->mode == MODE_CO_ALLOC) {
+            objs[i] = co_alloc(size);
+        } else {
+            objs[i] = NULL;
+        }
+        if (objs[i]) {
+            memset(objs[i], i, size < 64 ? size : 64);
+        }
+        if (i % (ALLOCS / YIELDS) == 0) {
+            co_yield();
+        }
+    }
+    if (req->mode == MODE_MALLOC) {
+        for (int i = 0; i < ALLOCS; i++) {
+            free(objs[i]);
+        }
+    }
+}
+
+struct result {
+    enum mode mode;
+    uint64_t ns;
+};
+
+static void *run(void *arg) {
+    struct result *res = (struct result *)arg;
+    static __thread struct request reqs[CONCURRENT];
+    static __thread struct co *cos[CONCURRENT];
+    uint64_t t0 = now_ns();
+    for (int done = 0; done < REQUESTS; done += CONCURRENT) {
+        for (int i = 0; i < CONCURRENT; i++) {
+            reqs[i].mode = res->mode;
+            reqs[i].seed = done + i;
+            cos[i] = co_start("request", handle, &reqs[i]);
+        }
+        for (int i = 0; i < CONCURRENT; i++) {
+            co_wait(cos[i]);
+        }
+    }
+    res->ns = now_ns() - t0;
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    int threads = argc > 1 ? atoi(argv[1]) : 1;
+    printf("%d thread(s) x %d requests x %d allocations\n", threads, REQUESTS, ALLOCS);
+    uint64_t base = 0;
+    for (int mode = MODE_NONE; mode <= MODE_CO_ALLOC; mode++) {
+        pthread_t tids[threads];
+        struct result res[threads];
+        for (int t = 0; t < threads; t++) {
+            res[t].mode = (enum mode)mode;
+            pthread_create(&tids[t], NULL, run, &res[t]);
+        }
+        uint64_t ns = 0;
+        for (int t = 0; t < threads; t++) {
+            pthread_join(tids[t], NULL);
+            ns += res[t].ns;
+        }
+        ns /= threads;
+        if (mode == MODE_NONE) {
+            base = ns;
+        }
+        printf("%-9s %8.1f ns/request   %6.1f ns/alloc over baseline\n", mode_names[mode],
+               (double)ns / REQUESTS, ((double)ns - (double)base) / ((double)REQUESTS * ALLOCS));
+    }
+    return 0;
+}
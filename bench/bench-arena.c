@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "co.h"
+#include "bench.h"
+
+// malloc 栈与 stack arena 在大量协程下的切换开销和 dTLB miss
+//   ./bench-arena [N...]    默认 10000 100000 1000000
+
+#define STACK_SIZE (32 * 1024) // 与 co.c 中的 CO_STACK_SIZE 一致, 用于估算内存
+#define TOTAL_SWITCHES 2000000
+
+struct config {
+    int num;
+    int arena;
+    int backing;
+    uint64_t ns;
+    uint64_t switches;
+    long long misses; // < 0 表示无法读取
+};
+
+static const char *backing_name[] = { "normal", "thp", "hugetlb" };
+
+static __thread int started;
+
+static void worker(void *arg) {
+    int rounds = *(int *)arg;
+    started++; // 第一次运行会触发缺页, 不计入测量
+    co_yield();
+    for (int i = 0; i < rounds; i++) {
+        co_yield();
+    }
+}
+
+static int dtlb_open() {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                  (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void *run(void *arg) {
+    struct config *cfg = (struct config *)arg;
+    int rounds = TOTAL_SWITCHES / cfg->num;
+    if (rounds < 2) rounds = 2;
+    cfg->backing = cfg->arena ? co_stack_arena(0, -1) : -1;
+
+    struct co **cos = malloc(sizeof(struct co *) * cfg->num);
+    for (int i = 0; i < cfg->num; i++) {
+        cos[i] = co_start("worker", worker, &rounds);
+    }
+
+    started = 0;
+    while (started < cfg->num) {
+        co_yield();
+    }
+
+    int fd = dtlb_open();
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < cfg->num; i++) {
+        co_wait(cos[i]);
+    }
+    cfg->ns = now_ns() - t0;
+    cfg->misses = -1;
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        long long count;
+        if (read(fd, &count, sizeof(count)) == sizeof(count)) {
+            cfg->misses = count;
+        }
+        close(fd);
+    }
+    cfg->switches = (uint64_t)cfg->num * (rounds + 1);
+    free(cos);
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    int defaults[] = { 10000, 100000, 1000000 };
+    int nums = argc > 1 ? argc - 1 : 3;
+    double avail = (double)sysconf(_SC_AVPHYS_PAGES) * sysconf(_SC_PAGESIZE);
+
+    printf("%9s %8s %8s %12s %14s\n", "coroutines", "stack", "backing", "ns/switch", "dTLB miss/sw");
+    for (int n = 0; n < nums; n++) {
+        int num = argc > 1 ? atoi(argv[n + 1]) : defaults[n];
+        // 大页下每个栈都会被完整占用, 按最坏情况估算
+        if ((double)num * STACK_SIZE > avail * 0.7) {
+            printf("%9d   skipped: needs ~%.0f MB, %.0f MB available\n",
+                   num, (double)num * STACK_SIZE / 1e6, avail / 1e6);
+            continue;
+        }
+        for (int arena = 0; arena <= 1; arena++) {
+            struct config cfg = { .num = num, .arena = arena };
+            pthread_t tid;
+            pthread_create(&tid, NULL, run, &cfg);
+            pthread_join(tid, NULL);
+            char miss[32] = "n/a";
+            if (cfg.misses >= 0) {
+                snprintf(miss, sizeof(miss), "%.3f", (double)cfg.misses / cfg.switches);
+            }
+            printf("%9d %8s %8s %12.1f %14s\n", num, arena ? "arena" : "malloc",
+                   cfg.backing >= 0 ? backing_name[cfg.backing] : "-",
+                   (double)cfg.ns / cfg.switches, miss);
+        }
+    }
+    return 0;
+}
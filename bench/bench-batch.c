@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "co.h"
+#include "bench.h"
+
+// 循环 co_start 与 co_start_batch 批量创建 N 个协程的开销
+
+#define NUM 10000
+
+static void worker(void *arg) {
+}
+
+struct result {
+    uint64_t spawn_ns;
+    uint64_t join_ns;
+};
+
+// 每种方式在新线程里跑, 互不影响
+static void *looped(void *arg) {
+    struct result *res = (struct result *)arg;
+    static struct co *cos[NUM];
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < NUM; i++) {
+        cos[i] = co_start("worker", worker, NULL);
+    }
+    uint64_t t1 = now_ns();
+    for (int i = 0; i < NUM; i++) {
+        co_wait(cos[i]);
+    }
+    res->spawn_ns = t1 - t0;
+    res->join_ns = now_ns() - t1;
+    return NULL;
+}
+
+static void *batched(void *arg) {
+    struct result *res = (struct result *)arg;
+    static struct co *cos[NUM];
+    uint64_t t0 = now_ns();
+    co_start_batch("worker", worker, NULL, NUM, cos);
+    uint64_t t1 = now_ns();
+    co_wait_batch(cos, NUM);
+    res->spawn_ns = t1 - t0;
+    res->join_ns = now_ns() - t1;
+    return NULL;
+}
+
+static void run(const char *name, void *(*fn)(void *)) {
+    struct result res;
+    pthread_t tid;
+    pthread_create(&tid, NULL, fn, &res);
+    pthread_join(tid, NULL);
+    // 栈的缺页可能发生在创建时 (malloc 写头部) 或第一次运行时, 总时间更有可比性
+    printf("%-14s spawn %8.1f ns/co   run+join %8.1f ns/co   total %8.1f ns/co\n", name,
+           (double)res.spawn_ns / NUM, (double)res.join_ns / NUM,
+           (double)(res.spawn_ns + res.join_ns) / NUM);
+}
+
+int main() {
+    printf("%d coroutines\n", NUM);
+    run("co_start", looped);
+    run("co_start_batch", batched);
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "co.h"
+#include "bench.h"
+
+// ping-pong: ping 写入时间戳后让出, pong 读到为止的延迟; 背景有 N 个一直 yield 的协程
+//   yield: ping/pong 各自 co_yield 轮询, 要等随机调度选中对方
+//   yield_to: 直接 co_yield_to 对方
+//   ./bench-handoff [N]    默认 1000
+
+#define BUCKETS 40
+
+struct result {
+    int num;
+    int handoff;
+    int rounds;
+    double ns_per_round;
+    unsigned long hist[BUCKETS]; // 延迟的 log2 直方图
+    unsigned long bg_runs;       // 期间背景协程运行的次数
+};
+
+static __thread struct result *res;
+static __thread struct co *ping_co, *pong_co;
+static __thread uint64_t sent; // 0 表示没有待读的消息
+static __thread int done;
+
+static void pass(struct co *to) {
+    if (res->handoff) {
+        co_yield_to(to);
+    } else {
+        co_yield();
+    }
+}
+
+static void pong(void *arg) {
+    for (int i = 0; i < res->rounds; i++) {
+        while (sent == 0) {
+            pass(ping_co);
+        }
+        uint64_t ns = now_ns() - sent;
+        int bucket = ns ? 63 - __builtin_clzll(ns) : 0;
+        res->hist[bucket < BUCKETS ? bucket : BUCKETS - 1]++;
+        sent = 0;
+        pass(ping_co);
+    }
+}
+
+static void ping(void *arg) {
+    for (int i = 0; i < res->rounds; i++) {
+        sent = now_ns();
+        while (sent != 0) {
+            pass(pong_co);
+        }
+    }
+}
+
+static void background(void *arg) {
+    while (!done) {
+        res->bg_runs++;
+        co_yield();
+    }
+}
+
+// 每种方式在新线程里跑, runtime 互不影响
+static void *run(void *arg) {
+    res = (struct result *)arg;
+    struct co **bg = malloc(sizeof(struct co *) * res->num);
+    for (int i = 0; i < res->num; i++) {
+        bg[i] = co_start("background", background, NULL);
+    }
+    uint64_t t0 = now_ns();
+    pong_co = co_start("pong", pong, NULL);
+    ping_co = co_start("ping", ping, NULL);
+    co_wait(ping_co);
+    co_wait(pong_co);
+    res->ns_per_round = (double)(now_ns() - t0) / res->rounds;
+    done = 1;
+    for (int i = 0; i < res->num; i++) {
+        co_wait(bg[i]);
+    }
+    free(bg);
+    return NULL;
+}
+
+// 第一个累计数量达到 q 的区间上限
+static unsigned long long quantile(unsigned long *hist, double q) {
+    unsigned long total = 0, acc = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        total += hist[i];
+    }
+    for (int i = 0; i < BUCKETS; i++) {
+        acc += hist[i];
+        if (acc >= total * q) {
+            return 2ull << i;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int num = argc > 1 ? atoi(argv[1]) : 1000;
+    // 随机调度平均要经过 N 次切换才轮到对方, 少跑一些
+    int rounds[2] = { 2000000 / (num + 2) + 1, 1000000 };
+    const char *names[2] = { "yield", "yield_to" };
+    printf("ping-pong with %d runnable background coroutines\n", num);
+    for (int h = 0; h < 2; h++) {
+        struct result r = { .num = num, .handoff = h, .rounds = rounds[h] };
+        pthread_t tid;
+        pthread_create(&tid, NULL, run, &r);
+        pthread_join(tid, NULL);
+        printf("%-9s %8d rounds   %10.1f ns/round   latency p50 < %llu ns   p99 < %llu ns   "
+               "background runs %.2f/round\n",
+               names[h], r.rounds, r.ns_per_round, quantile(r.hist, 0.5), quantile(r.hist, 0.99),
+               (double)r.bg_runs / r.rounds);
+    }
+    return 0;
+}
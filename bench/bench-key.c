@@ -0,0 +1,49 @@
+#include <stdio.h>
+#include "co.h"
+#include "bench.h"
+
+// 协程局部存储 co_getspecific 与 __thread 访问的对比
+
+#define ITERS 100000000
+
+static __thread void *tls_value;
+static int inline_key, ext_key;
+
+static void run(void *arg) {
+    volatile uintptr_t sink = 0;
+    uint64_t t0, t1;
+
+    t0 = now_ns();
+    for (int i = 0; i < ITERS; i++) {
+        sink += (uintptr_t)tls_value;
+        __asm__ volatile("" ::: "memory");
+    }
+    t1 = now_ns();
+    printf("__thread:              %6.2f ns/op\n", (double)(t1 - t0) / ITERS);
+
+    t0 = now_ns();
+    for (int i = 0; i < ITERS; i++) {
+        sink += (uintptr_t)co_getspecific(inline_key);
+    }
+    t1 = now_ns();
+    printf("co_getspecific inline: %6.2f ns/op\n", (double)(t1 - t0) / ITERS);
+
+    t0 = now_ns();
+    for (int i = 0; i < ITERS; i++) {
+        sink += (uintptr_t)co_getspecific(ext_key);
+    }
+    t1 = now_ns();
+    printf("co_getspecific ext:    %6.2f ns/op\n", (double)(t1 - t0) / ITERS);
+}
+
+int main() {
+    inline_key = co_key_create(NULL);
+    for (int i = 1; i < CO_KEY_MAX; i++) {
+        ext_key = co_key_create(NULL);
+    }
+    tls_value = &tls_value;
+    struct co *co = co_start("key", run, NULL);
+    co_setspecific(inline_key, &inline_key); // main 协程的值, 不影响 co
+    co_wait(co);
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include "co.h"
+#include "bench.h"
+
+// 外部线程通过 co_post 投递工作:
+//   flood: 连续投递, 统计 co_post 本身的开销
+//   paced: 上一个开始执行后才投递下一个, 统计投递到开始执行的延迟 (含 eventfd 唤醒)
+
+#define FLOOD_NUM 200000
+#define PACED_NUM 20000
+
+struct job {
+    uint64_t posted;
+    uint64_t started;
+};
+
+static struct job jobs[PACED_NUM];
+static struct co_runtime *runtime;
+static struct co *waiter;
+static int done, expect;
+static uint64_t submit_ns;
+
+static void job_entry(void *arg) {
+    struct job *job = (struct job *)arg;
+    if (job) {
+        __atomic_store_n(&job->started, now_ns(), __ATOMIC_RELEASE);
+    }
+    if (++done == expect) {
+        co_wake_external(waiter);
+    }
+}
+
+static void *flood(void *arg) {
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < FLOOD_NUM; i++) {
+        co_post(runtime, job_entry, NULL);
+    }
+    submit_ns = now_ns() - t0;
+    return NULL;
+}
+
+static void *paced(void *arg) {
+    for (int i = 0; i < PACED_NUM; i++) {
+        jobs[i].posted = now_ns();
+        co_post(runtime, job_entry, &jobs[i]);
+        while (__atomic_load_n(&jobs[i].started, __ATOMIC_ACQUIRE) == 0) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void run(void *(*producer)(void *), int num) {
+    pthread_t tid;
+    done = 0;
+    expect = num;
+    pthread_create(&tid, NULL, producer, NULL);
+    while (done < num) {
+        co_park();
+    }
+    pthread_join(tid, NULL);
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+int main() {
+    runtime = co_runtime_current();
+    waiter = co_self();
+
+    run(flood, FLOOD_NUM);
+    printf("co_post submit:   %8.1f ns/op\n", (double)submit_ns / FLOOD_NUM);
+
+    run(paced, PACED_NUM);
+    uint64_t *lat = malloc(sizeof(uint64_t) * PACED_NUM);
+    for (int i = 0; i < PACED_NUM; i++) {
+        lat[i] = jobs[i].started - jobs[i].posted;
+    }
+    qsort(lat, PACED_NUM, sizeof(uint64_t), cmp_u64);
+    printf("post -> run p50:  %8.1f us\n", lat[PACED_NUM / 2] / 1e3);
+    printf("post -> run p99:  %8.1f us\n", lat[PACED_NUM / 100 * 99] / 1e3);
+    free(lat);
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "co.h"
+#include "bench.h"
+
+// 1 kHz 采样对运行速度的影响, 并输出 folded 格式的样本 (bench-prof.folded)
+//   ./flamegraph.pl bench-prof.folded > bench-prof.svg
+
+#define ROUNDS 2000
+
+static volatile unsigned long spin;
+
+__attribute__((noinline)) void burn(int n) {
+    for (int i = 0; i < n; i++) {
+        spin++;
+    }
+}
+
+__attribute__((noinline)) void hot_path() {
+    burn(30000);
+}
+
+__attribute__((noinline)) void cold_path() {
+    burn(10000);
+}
+
+void hot(void *arg) {
+    for (int i = 0; i < ROUNDS; i++) {
+        hot_path();
+        co_yield();
+    }
+}
+
+void cold(void *arg) {
+    for (int i = 0; i < ROUNDS; i++) {
+        cold_path();
+        co_yield();
+    }
+}
+
+static uint64_t run() {
+    uint64_t t0 = now_ns();
+    struct co *a = co_start("hot", hot, NULL);
+    struct co *b = co_start("cold", cold, NULL);
+    co_wait(a);
+    co_wait(b);
+    return now_ns() - t0;
+}
+
+int main() {
+    uint64_t base = run();
+    co_prof_start(1000);
+    uint64_t prof = run();
+    co_prof_dump("bench-prof.folded");
+    co_prof_stop();
+
+    printf("without profiler: %8.2f ms\n", base / 1e6);
+    printf("with 1 kHz:       %8.2f ms (%+.2f%%)\n", prof / 1e6, (double)prof / base * 100 - 100);
+
+    FILE *fp = fopen("bench-prof.folded", "r");
+    char line[4096];
+    while (fp && fgets(line, sizeof(line), fp)) {
+        printf("  %s", line);
+    }
+    if (fp) {
+        fclose(fp);
+    }
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <functional>
+#include <vector>
+#include "co.hpp"
+#include "bench.h"
+
+// 创建带 3 个捕获的协程的开销
+//   c: co_start + 预先准备好的参数数组, 不分配
+//   heap closure: 每次 new 一个 std::function 作为 arg
+//   toyco::spawn: 捕获放在协程栈顶
+//   每轮创建 N 个再全部 join 并释放; 三种方式交替跑 REPEAT 次, 取最好的一次
+
+#define N 10000
+#define ROUNDS 20
+#define REPEAT 5
+
+struct args {
+    long *sum;
+    int i;
+    double scale;
+};
+
+static void c_func(void *arg) {
+    struct args *a = (struct args *)arg;
+    *a->sum += (long)(a->i * a->scale);
+}
+
+static void closure_func(void *arg) {
+    std::function<void()> *f = static_cast<std::function<void()> *>(arg);
+    (*f)();
+    delete f;
+}
+
+struct result {
+    double spawn_ns;
+    double total_ns;
+};
+
+template <typename Spawn, typename Join>
+static result run(Spawn spawn, Join join) {
+    uint64_t spawn_ns = 0, total_ns = 0;
+    for (int r = 0; r < ROUNDS; r++) {
+        uint64_t t0 = now_ns();
+        for (int i = 0; i < N; i++) {
+            spawn(i);
+        }
+        uint64_t t1 = now_ns();
+        join();
+        uint64_t t2 = now_ns();
+        spawn_ns += t1 - t0;
+        total_ns += t2 - t0;
+    }
+    return { (double)spawn_ns / ((double)N * ROUNDS), (double)total_ns / ((double)N * ROUNDS) };
+}
+
+int main() {
+    long sum = 0;
+    double scale = 1.0;
+    std::vector<struct co *> cos(N);
+    std::vector<struct args> args(N);
+    std::vector<toyco::task> tasks;
+    tasks.reserve(N);
+
+    auto join_cos = [&] {
+        for (int i = 0; i < N; i++) {
+            co_wait(cos[i]);
+            co_detach(cos[i]);
+        }
+    };
+    auto best = [](result &a, result b) {
+        a.spawn_ns = a.spawn_ns < b.spawn_ns ? a.spawn_ns : b.spawn_ns;
+        a.total_ns = a.total_ns < b.total_ns ? a.total_ns : b.total_ns;
+    };
+    result c = { 1e18, 1e18 }, heap = c, spawn = c;
+    for (int k = 0; k < REPEAT; k++) {
+        best(c, run([&](int i) {
+            args[i] = { &sum, i, scale };
+            cos[i] = co_start("c", c_func, &args[i]);
+        }, join_cos));
+        best(heap, run([&](int i) {
+            long *s = &sum;
+            auto *f = new std::function<void()>([s, i, scale] { *s += (long)(i * scale); });
+            cos[i] = co_start("closure", closure_func, f);
+        }, join_cos));
+        best(spawn, run([&](int i) {
+            long *s = &sum;
+            tasks.push_back(toyco::spawn("spawn", [s, i, scale] { *s += (long)(i * scale); }));
+        }, [&] {
+            tasks.clear(); // 析构时 join
+        }));
+    }
+
+    printf("%d coroutines x %d rounds, 3 captures, best of %d (sum %ld)\n", N, ROUNDS, REPEAT, sum);
+    printf("c co_start      spawn %6.1f ns   spawn+run+join %6.1f ns\n", c.spawn_ns, c.total_ns);
+    printf("heap closure    spawn %6.1f ns   spawn+run+join %6.1f ns\n", heap.spawn_ns, heap.total_ns);
+    printf("toyco::spawn    spawn %6.1f ns   spawn+run+join %6.1f ns\n", spawn.spawn_ns, spawn.total_ns);
+    return 0;
+}
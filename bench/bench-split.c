@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "co.h"
+#include "bench.h"
+
+// 大量浅栈协程下, 固定栈与 split stack 的内存占用和切换开销
+//   bench-split:    链接 libco-64.so (固定 32KB 栈)
+//   bench-split-ss: 以 -fsplit-stack 编译并链接 libco-ss-64.so
+//   ./bench-split[-ss] [N]    默认 1000000
+//   split stack 的每个初始栈段是单独的 mmap, 受 vm.max_map_count 限制 (默认 65530),
+//   超过时 libgcc 释放栈段会失败并 abort, 所以 -ss 版本把 N 限制在它以内
+
+#define ROUNDS 4
+#define DEEP_EVERY 1000 // 每 1000 个协程中有一个用到较深的栈
+
+static int started;
+
+__attribute__((noinline)) static int deep(int n) {
+    volatile char buf[1024];
+    buf[0] = (char)n;
+    return n == 0 ? buf[0] : deep(n - 1) + buf[0];
+}
+
+static void worker(void *arg) {
+    if ((intptr_t)arg % DEEP_EVERY == 0) {
+        deep(16); // ~16KB
+    }
+    started++;
+    for (int i = 0; i < ROUNDS; i++) {
+        co_yield();
+    }
+}
+
+// 读不到时返回 -1
+static long max_map_count() {
+    FILE *fp = fopen("/proc/sys/vm/max_map_count", "r");
+    long n = -1;
+    if (fp) {
+        if (fscanf(fp, "%ld", &n) != 1) {
+            n = -1;
+        }
+        fclose(fp);
+    }
+    return n;
+}
+
+static long rss_kb() {
+    FILE *fp = fopen("/proc/self/status", "r");
+    char line[256];
+    long kb = -1;
+    while (fp && fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, "VmRSS:", 6) == 0) {
+            kb = atol(line + 6);
+        }
+    }
+    if (fp) {
+        fclose(fp);
+    }
+    return kb;
+}
+
+int main(int argc, char *argv[]) {
+    int num = argc > 1 ? atoi(argv[1]) : 1000000;
+#ifdef CO_SPLIT_STACK
+    // 留一些给共享库、malloc 等其他映射
+    long maps = max_map_count() - 1000;
+    if (maps > 0 && num > maps) {
+        printf("%s: vm.max_map_count allows ~%ld split-stack coroutines, running %ld instead of %d\n",
+               argv[0], maps, maps, num);
+        num = (int)maps;
+    }
+#endif
+    // 固定栈每个协程至少占 2 个页, 按这个估算是否放得下
+    double avail = (double)sysconf(_SC_AVPHYS_PAGES) * sysconf(_SC_PAGESIZE);
+    if ((double)num * 10 * 1024 > avail * 0.8) {
+        printf("%s: %d coroutines need ~%.0f MB, %.0f MB available; run with a smaller N\n",
+               argv[0], num, (double)num * 10 * 1024 / 1e6, avail / 1e6);
+        return 0;
+    }
+    struct co **cos = malloc(sizeof(struct co *) * num);
+    long rss0 = rss_kb();
+    for (int i = 0; i < num; i++) {
+        cos[i] = co_start("worker", worker, (void *)(intptr_t)i);
+    }
+    while (started < num) {
+        co_yield();
+    }
+    long rss1 = rss_kb();
+
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < num; i++) {
+        co_wait(cos[i]);
+    }
+    uint64_t t1 = now_ns();
+    printf("%-16s %8d coroutines   rss %8.1f MB (%6.2f KB/co)   %7.1f ns/switch\n",
+           argv[0], num, (rss1 - rss0) / 1024.0, (double)(rss1 - rss0) / num,
+           (double)(t1 - t0) / ((double)num * ROUNDS));
+    free(cos);
+    return 0;
+}
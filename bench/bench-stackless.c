@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "co.h"
+#include "bench.h"
+
+// 同样的小状态机分别用无栈协程和有栈协程实现, 比较每个协程的内存和每次切换的开销
+//   ./bench-stackless [N]    默认 1000000; 有栈协程最多 100000 个
+
+#define ROUNDS 4
+#define STACKFUL_MAX 100000
+
+static int started;
+
+struct frame {
+    int i;
+    int sum;
+};
+
+static int sl_worker(int *pc, void *frame) {
+    struct frame *f = (struct frame *)frame;
+    CO_SL_BEGIN(pc);
+    started++;
+    for (f->i = 0; f->i < ROUNDS; f->i++) {
+        f->sum += f->i;
+        CO_SL_YIELD(pc);
+    }
+    CO_SL_END(pc);
+}
+
+static void worker(void *arg) {
+    struct frame f = {0, 0};
+    started++;
+    for (f.i = 0; f.i < ROUNDS; f.i++) {
+        f.sum += f.i;
+        co_yield();
+    }
+}
+
+static long rss_kb() {
+    FILE *fp = fopen("/proc/self/status", "r");
+    char line[256];
+    long kb = -1;
+    while (fp && fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, "VmRSS:", 6) == 0) {
+            kb = atol(line + 6);
+        }
+    }
+    if (fp) {
+        fclose(fp);
+    }
+    return kb;
+}
+
+// 每种方式在单独的进程里跑, RSS 互不影响
+static void run(const char *name, int num, int stackless) {
+    if (fork() != 0) {
+        wait(NULL);
+        return ;
+    }
+    struct co **cos = malloc(sizeof(struct co *) * num);
+    long rss0 = rss_kb();
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < num; i++) {
+        if (stackless) {
+            cos[i] = co_start_sl("sl_worker", sl_worker, NULL, sizeof(struct frame));
+        } else {
+            cos[i] = co_start("worker", worker, NULL);
+        }
+    }
+    uint64_t t1 = now_ns();
+    while (started < num) {
+        co_yield();
+    }
+    long rss1 = rss_kb();
+    uint64_t t2 = now_ns();
+    for (int i = 0; i < num; i++) {
+        co_wait(cos[i]);
+    }
+    uint64_t t3 = now_ns();
+    printf("%-10s %8d coroutines   spawn %6.1f ns/co   rss %8.1f MB (%7.1f B/co)   %6.1f ns/switch\n",
+           name, num, (double)(t1 - t0) / num, (rss1 - rss0) / 1024.0,
+           (double)(rss1 - rss0) * 1024 / num, (double)(t3 - t2) / ((double)num * ROUNDS));
+    exit(0);
+}
+
+int main(int argc, char *argv[]) {
+    int num = argc > 1 ? atoi(argv[1]) : 1000000;
+    run("stackless", num, 1);
+    run("stackful", num < STACKFUL_MAX ? num : STACKFUL_MAX, 0);
+    return 0;
+}
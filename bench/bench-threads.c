@@ -0,0 +1,48 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "co.h"
+#include "bench.h"
+
+// 每个线程跑一个独立的 yield ping-pong, 线程数从 1 增加到 N
+
+#define ITERS 200000
+
+static void pingpong(void *arg) {
+    for (int i = 0; i < ITERS; i++) {
+        co_yield();
+    }
+}
+
+static void *shard(void *arg) {
+    struct co *a = co_start("ping", pingpong, NULL);
+    struct co *b = co_start("pong", pingpong, NULL);
+    co_wait(a);
+    co_wait(b);
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    int max_threads = argc > 1 ? atoi(argv[1]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (max_threads < 1) max_threads = 1;
+    pthread_t *tids = malloc(sizeof(pthread_t) * max_threads);
+    double base = 0;
+
+    printf("%8s %12s %14s %8s\n", "threads", "time(ms)", "switch/s", "scale");
+    for (int n = 1; n <= max_threads; n++) {
+        uint64_t t0 = now_ns();
+        for (int i = 0; i < n; i++) {
+            pthread_create(&tids[i], NULL, shard, NULL);
+        }
+        for (int i = 0; i < n; i++) {
+            pthread_join(tids[i], NULL);
+        }
+        uint64_t t1 = now_ns();
+        double rate = (double)n * 2 * ITERS / ((t1 - t0) / 1e9);
+        if (n == 1) base = rate;
+        printf("%8d %12.2f %14.0f %8.2f\n", n, (t1 - t0) / 1e6, rate, rate / base);
+    }
+    free(tids);
+    return 0;
+}
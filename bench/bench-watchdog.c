@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "co.h"
+#include "bench.h"
+
+// watchdog 对切换开销的影响, 以及随机调度下 "可运行到被选中" 的等待分布
+//   ./bench-watchdog [N]    N 个协程 (默认 100) 各自 yield
+
+#define SWITCHES 2000000
+
+struct result {
+    int num;
+    int watchdog;
+    double ns_per_switch;
+    unsigned long wait[CO_WD_BUCKETS];
+};
+
+static int rounds;
+
+static void worker(void *arg) {
+    for (int i = 0; i < rounds; i++) {
+        co_yield();
+    }
+}
+
+// 每种配置在新线程里跑, runtime 互不影响
+static void *run(void *arg) {
+    struct result *res = (struct result *)arg;
+    struct co **cos = malloc(sizeof(struct co *) * res->num);
+    if (res->watchdog) {
+        co_watchdog_start(0, 0, NULL, NULL); // 只统计, 不报告
+    }
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < res->num; i++) {
+        cos[i] = co_start("worker", worker, NULL);
+    }
+    for (int i = 0; i < res->num; i++) {
+        co_wait(cos[i]);
+    }
+    res->ns_per_switch = (double)(now_ns() - t0) / ((double)res->num * rounds);
+    if (res->watchdog) {
+        co_watchdog_hist(CO_WD_WAIT, res->wait);
+        co_watchdog_stop();
+    }
+    free(cos);
+    return NULL;
+}
+
+// 第一个累计数量达到 q 的区间上限
+static unsigned long long quantile(unsigned long *hist, double q) {
+    unsigned long total = 0, acc = 0;
+    for (int i = 0; i < CO_WD_BUCKETS; i++) {
+        total += hist[i];
+    }
+    for (int i = 0; i < CO_WD_BUCKETS; i++) {
+        acc += hist[i];
+        if (acc >= total * q) {
+            return 2ull << i;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    int num = argc > 1 ? atoi(argv[1]) : 100;
+    rounds = SWITCHES / num;
+    struct result res[2];
+    for (int w = 0; w < 2; w++) {
+        pthread_t tid;
+        res[w].num = num;
+        res[w].watchdog = w;
+        pthread_create(&tid, NULL, run, &res[w]);
+        pthread_join(tid, NULL);
+    }
+    printf("%d coroutines x %d yields\n", num, rounds);
+    printf("watchdog off   %7.1f ns/switch\n", res[0].ns_per_switch);
+    printf("watchdog on    %7.1f ns/switch   (+%.1f ns)\n", res[1].ns_per_switch,
+           res[1].ns_per_switch - res[0].ns_per_switch);
+    printf("runnable wait  p50 < %llu ns   p99 < %llu ns   p99.99 < %llu ns   max < %llu ns\n",
+           quantile(res[1].wait, 0.5), quantile(res[1].wait, 0.99),
+           quantile(res[1].wait, 0.9999), quantile(res[1].wait, 1.0));
+    return 0;
+}
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include "list.h"
 #include "co.h"
 #include <stdint.h>
@@ -5,21 +6,33 @@
 #include <stdio.h>
 #include <setjmp.h>
 #include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/eventfd.h>
+#include <signal.h>
+#include <time.h>
+#include <dlfcn.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 
 // this function is used to switch stack and start a function on the new stack
 //   ! this function never return
-static inline void
+//   frame pointer is cleared so that unwinding stops at the entry frame
+//   no_split_stack: 不内联时它在栈下限已切到新栈之后才执行, 不能再做栈检查
+static inline __attribute__((no_split_stack)) void
 stack_switch_call(void *sp, void *entry, uintptr_t arg) {
     asm volatile (
 #if __x86_64__
-        "movq %0, %%rsp; movq %2, %%rdi; jmp *%1"
+        "movq %0, %%rsp; movq %2, %%rdi; xorl %%ebp, %%ebp; jmp *%1"
           :
           : "b"((uintptr_t)sp - 8),
             "d"(entry),
             "a"(arg)
           : "memory"
 #else
-        "movl %0, %%esp; movl %2, 4(%0); jmp *%1"
+        "movl %0, %%esp; movl %2, 4(%0); xorl %%ebp, %%ebp; jmp *%1"
         :
         : "b"((uintptr_t)sp - 8),
             "d"(entry),
@@ -48,17 +61,74 @@ stack_switch_call(void *sp, void *entry, uintptr_t arg) {
     } \
 } while (0)
 
-#define CO_RUNTIME_STACK_SIZE (4 * 1024) // 4KB
+#define CO_RUNTIME_STACK_SIZE (64 * 1024) // 64KB, 无栈协程也在这上面执行
+#ifdef CO_SPLIT_STACK
+#define CO_STACK_SIZE (4 * 1024) // 初始段 4KB, 之后由 __morestack 按需增长
+#else
 #define CO_STACK_SIZE (32 * 1024) // 32KB
-#define MAX_CO_NUM 1024
+#endif
+#define CO_TABLE_INIT_CAP 64
+#define CO_POST_MAX_LIVE 1024 // 同时存活的 co_post 协程上限, 超过的留在队列里
+#define CO_KEY_INLINE 8  // 前几个 key 直接存在 struct co 里
+#define CO_KEY_DTOR_ITERATIONS 4
+#define CO_PROF_DEPTH 32           // 每个样本最多回溯的栈帧数
+#define CO_PROF_NAME 32
+#define CO_PROF_SAMPLES (64 * 1024) // 两次 co_prof_dump 之间最多保存的样本数
+#define CO_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define CO_ARENA_REGION_SIZE (64 * 1024 * 1024) // co_stack_arena 默认每次映射的大小
+#define CO_MPOL_BIND 2 // <numaif.h> 中的 MPOL_BIND, 不依赖 libnuma
+#define CO_TSC_CALIBRATE_NS (10 * 1000 * 1000) // 用 10ms 估计 TSC 频率
+#define CO_CHUNK_SIZE (16 * 1024)  // co_alloc 每次从池中取的块
+#define CO_CHUNK_CACHE 64          // 每个 runtime 缓存的空闲块, 多出的还给全局池
+#define CO_CHUNK_POOL_MAX 1024     // 全局池最多保留的空闲块
+
+#ifdef CO_SPLIT_STACK
+// -fsplit-stack: 每个协程有一组栈段, 切换时把 TCB 中的栈下限一起切换 (libgcc generic-morestack.c)
+void *__splitstack_makecontext(size_t stack_size, void *context[10], size_t *size);
+void __splitstack_getcontext(void *context[10]);
+void __splitstack_setcontext(void *context[10]);
+void __splitstack_releasecontext(void *context[10]);
+
+// 不检查栈下限的函数: 调度器本身和信号处理函数
+#define CO_NO_SPLIT __attribute__((no_split_stack))
+
+// 切到 runtime 栈之前关闭栈下限检查, 直到 co_schedule 设置下一个协程的栈段
+static inline void co_split_guard_clear() {
+#if __x86_64__
+    asm volatile ("movq $0, %%fs:0x70" ::: "memory");
+#else
+    asm volatile ("movl $0, %%gs:0x30" ::: "memory");
+#endif
+}
+#else
+#define CO_NO_SPLIT
+#endif
+
+// watchdog 的时间戳, 换出时读一次, 换入时通常直接复用
+static inline uint64_t co_rdtsc() {
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline uint64_t co_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
 
 void co_wrapper(struct co *co);
+void co_free(struct co *co);
+static void co_sl_step(struct co *co);
+static void co_init(struct co *co, void (*func)(void *), void *arg, struct co *parent);
+static struct co *co_create(const char *name, void (*func)(void *), void *arg, struct co *parent);
 
 
 enum co_status {
     CO_NEW = 1, // 新创建，还未执行过
     CO_RUNNING, // 已经执行过
     CO_WAITING, // 在 co_wait 上等待
+    CO_PARKED,  // 在 co_park 上等待外部唤醒
     CO_DEAD,    // 已经结束，但还未释放资源
 };
 
@@ -67,92 +137,656 @@ struct co_list_node {
     struct co *co;
 };
 
+// co_alloc 的内存块, 数据紧跟在块头之后
+struct co_chunk {
+    struct co_chunk *next;
+    size_t size;  // 数据部分的大小, 大于 CO_CHUNK_SIZE 的单独分配, 不进入池
+} __attribute__((aligned(16)));
+
+struct co_cleanup {
+    void (*fn)(void *);
+    void *arg;
+    struct co_cleanup *next;
+};
+
+// co_start_batch 一次分配的所有协程: 控制块和栈在同一块连续映射中
+//   [struct co_batch][struct co * num][name] (按页对齐) [stack * num]
+struct co_batch {
+    size_t ctrl_size;  // 栈之前的部分
+    size_t stack_size; // 所有栈, 全部结束后提前归还
+    int num;
+    int alive;         // 还没结束的协程数
+    int refs;          // 还没 co_free 的协程数
+    struct co *joiner; // co_wait_batch 中等待的协程
+};
+
 struct co {
+    // 无栈协程只分配到 arg 之前的部分 (CO_SL_HEAD), 后面紧跟它的 frame
     char *name;
-    void (*func)(void *); // co_start 指定的入口地址和参数
-    void *arg;
-    
-    enum co_status status;  // 协程的状态
+    void (*func)(void *); // co_start 指定的入口地址; 无栈协程为 co_sl_func
     struct list_head waiters; // 当前协程在等待哪些协程
+    enum co_status status;  // 协程的状态
+    int            idx;     // 在所属 co_table 中的下标
+    int            stackless; // 由 co_start_sl 创建; CO_SL_DETACHED 表示结束时直接释放
+    int            pc;      // 无栈协程的恢复点
+
+    void *arg;
+    void *specific[CO_KEY_INLINE]; // 协程局部存储
+    void **specific_ext;           // key >= CO_KEY_INLINE 的部分, 按需分配
     jmp_buf        context; // 寄存器现场
+#ifdef CO_SPLIT_STACK
+    void           *split_context[10]; // 栈段链表和栈下限
+    size_t          split_size; // 初始段的实际大小, 栈顶 = stack + split_size
+#endif
     uint8_t        *stack;  // 协程的堆栈
+    int            stack_arena; // 堆栈来自 runtime 的 stack arena
+    size_t         stack_inline; // co_start_inline 在栈顶保留给参数的字节数
+    struct co_batch *batch; // 由 co_start_batch 创建
+    struct co_chunk *region;          // co_alloc 用过的块, 结束时一起归还
+    uint8_t *region_cur, *region_end; // 当前块中还没分配的部分
+
+    struct co_runtime *runtime; // 所属的 runtime (线程)
+    int detached;     // 无人等待, 结束时直接释放
+    int posted;       // 由 co_post 创建, 计入 post_live
+    int wake_pending; // co_park 之前已经收到的唤醒
+
+    int canceled;                   // 已被 co_cancel
+    struct co_list_node *wait_node; // co_wait 时挂在目标 waiters 上的节点
+    struct co_cleanup *cleanup;     // 清理函数栈
+    struct co *parent;              // 创建者, 用于按子树取消
+    struct list_head children;
+    struct list_head sibling;
 };
 
+// 无栈协程的 co_detach 标记, 控制块里放不下 detached 字段
+#define CO_SL_DETACHED 2
+
+// 无栈协程的控制块大小, frame 按 16 字节对齐
+#define CO_SL_HEAD ((offsetof(struct co, arg) + 15) & ~(size_t)15)
+
+// 每个协程同一时刻只在一张表里, co->idx 记录它在表中的位置
 struct co_table {
-    struct co *tab[MAX_CO_NUM];
+    struct co **tab;
+    uint64_t *stamp; // 只有开启 watchdog 时的 run_table 才有: 每个协程变为可运行的时间
     int num;
+    int cap;
 };
 
-struct co_table co_wait_table;
-struct co_table co_run_table;
-struct co_table co_dead_table;
-
 void co_table_init(struct co_table *table) {
+    table->stamp = NULL;
     table->num = 0;
-    for (int i = 0; i < MAX_CO_NUM; i++) {
-        table->tab[i] = NULL;
+    table->cap = CO_TABLE_INIT_CAP;
+    table->tab = (struct co **)calloc(table->cap, sizeof(struct co *));
+    if (table->tab == NULL) {
+        panic("malloc co_table failed\n");
+    }
+}
+
+void co_table_reserve(struct co_table *table, int extra) {
+    if (table->num + extra <= table->cap) {
+        return ;
+    }
+    while (table->num + extra > table->cap) {
+        table->cap *= 2;
+    }
+    table->tab = (struct co **)realloc(table->tab, table->cap * sizeof(struct co *));
+    if (table->tab == NULL) {
+        panic("realloc co_table failed\n");
+    }
+    if (table->stamp) {
+        table->stamp = (uint64_t *)realloc(table->stamp, table->cap * sizeof(uint64_t));
+        if (table->stamp == NULL) {
+            panic("realloc co_table stamp failed\n");
+        }
     }
 }
 
 void co_table_add(struct co_table *table, struct co *co) {
+    co_table_reserve(table, 1);
+    co->idx = table->num;
+    if (table->stamp) {
+        table->stamp[co->idx] = co_rdtsc();
+    }
     table->tab[table->num++] = co;
 }
 
 void co_table_del_idx(struct co_table *table, int index) {
     // move the tail to the deleted position
     table->tab[index] = table->tab[--table->num];
+    table->tab[index]->idx = index;
     table->tab[table->num] = NULL;
+    if (table->stamp) {
+        table->stamp[index] = table->stamp[table->num];
+    }
 }
 
 void co_table_del_co(struct co_table *table, struct co *co) {
-    for (int i = 0; i < table->num; i++) {
-        if (table->tab[i] == co) {
-            co_table_del_idx(table, i);
-            return ;
-        }
-    }
+    assert(co->idx < table->num && table->tab[co->idx] == co);
+    co_table_del_idx(table, co->idx);
 }
 
-struct co* co_current;
-#define current (co_current)
+void co_table_free(struct co_table *table) {
+    free(table->tab);
+    free(table->stamp);
+    table->tab = NULL;
+    table->stamp = NULL;
+    table->num = table->cap = 0;
+}
+
+// 每个线程一个独立的 runtime, 线程之间互不干扰
+enum co_post_kind {
+    CO_POST_FN = 1, // 在新协程中执行 fn(arg)
+    CO_POST_WAKE,   // 唤醒 co_park 中的协程
+};
+
+struct co_post_node {
+    struct co_post_node *next;
+    enum co_post_kind kind;
+    void (*fn)(void *);
+    void *arg;
+    struct co *co;
+};
+
+struct co_prof_sample {
+    char name[CO_PROF_NAME];
+    int depth;
+    uintptr_t pc[CO_PROF_DEPTH]; // pc[0] 是被打断的位置, 之后是返回地址
+};
+
+struct co_prof {
+    timer_t timer;
+    uintptr_t main_lo, main_hi; // 线程自己的栈, 给 main 协程回溯用
+    volatile int num;
+    unsigned long dropped;
+    struct co_prof_sample samples[CO_PROF_SAMPLES];
+};
+
+struct co_stack_region {
+    uint8_t *base;
+    size_t size;
+    struct co_stack_region *next;
+};
+
+// 从大块内存 (尽量是大页) 中切出协程栈, 减少 TLB miss
+struct co_stack_arena {
+    int enabled;
+    int backing;        // enum co_arena_backing
+    int numa_node;      // < 0 表示不绑定
+    size_t region_size;
+    uint8_t *cur, *end; // 当前 region 中还没切出去的部分
+    struct co_stack_region *regions;
+    void *free_list;    // 回收的栈, 链表指针放在栈顶
+};
+
+struct co_watchdog {
+    double ns_per_tsc;
+    uint64_t slice_tsc, wait_tsc; // 阈值, 0 表示不检查
+    uint64_t in;                  // current 换入的时间, 0 表示已经记录过换出
+    uint64_t out;                 // 上次换出的时间, 0 表示之后阻塞过, 需要重新读
+    co_wd_func fn;                // 为 NULL 时输出到 stderr
+    void *arg;
+    unsigned long hist[2][CO_WD_BUCKETS];
+};
+
+struct co_runtime {
+    struct co *current;
+    struct co main_co;          // 线程本身的执行流
+    struct co_table wait_table;
+    struct co_table run_table;
+    struct co_table dead_table;
+    unsigned int seed;          // rand_r 的种子, 避免 rand() 的全局锁
+    struct co *handoff;         // co_yield_to 指定的下一个协程, 只用一次
+
+    // 其他线程投递过来的工作, 无锁 MPSC 栈, 由 co_schedule 批量取出
+    struct co_post_node *post_head;
+    struct co_post_node *post_defer, *post_defer_tail; // 存活的 co_post 协程太多, 暂缓创建的
+    int idle;                   // runtime 阻塞在 efd 上
+    int efd;                    // 空闲时用来唤醒的 eventfd
+
+    struct co_prof *prof;       // co_prof_start 之后才有
+    struct co_watchdog *wd;     // co_watchdog_start 之后才有
+    struct co_stack_arena arena;
+    int post_live;              // 存活的 co_post 协程数
+    struct co_chunk *chunk_cache; // co_alloc 的空闲块
+    int chunk_cached;
+    uint8_t stack[CO_RUNTIME_STACK_SIZE] __attribute__((aligned(16))); // 用于 runtime 的栈
+};
+
+// initial-exec: 访问 co_rt 只需一次 %fs 相对寻址, 不走 __tls_get_addr
+static __thread struct co_runtime *co_rt __attribute__((tls_model("initial-exec")));
+
+static pthread_key_t co_rt_key;
+static pthread_once_t co_rt_key_once = PTHREAD_ONCE_INIT;
 
-static struct co main_co;
-uint8_t co_runtime_stack[CO_RUNTIME_STACK_SIZE]; // 用于 runtime 的栈
+static void co_runtime_destroy(struct co_runtime *r);
 
-__attribute__((constructor))
-static void co_init() {
-    debug("co_init\n");
+static void co_rt_key_dtor(void *arg) {
+    co_runtime_destroy((struct co_runtime *)arg);
+}
+
+static void co_rt_key_init() {
+    if (pthread_key_create(&co_rt_key, co_rt_key_dtor) != 0) {
+        panic("pthread_key_create failed\n");
+    }
+}
+
+static struct co_runtime *co_runtime_init() {
+    debug("co_runtime_init\n");
+    struct co_runtime *r = (struct co_runtime *)malloc(sizeof(struct co_runtime));
+    if (r == NULL) {
+        panic("malloc co_runtime failed\n");
+    }
     // 初始化协程表
-    co_table_init(&co_wait_table);
-    co_table_init(&co_run_table);
-    co_table_init(&co_dead_table);
-    
-    // 初始化主协程
-    main_co.name = "main"; 
-    main_co.func = NULL;
-    main_co.arg = NULL;
-    main_co.status = CO_RUNNING;
-    INIT_LIST_HEAD(&main_co.waiters);
-    main_co.stack = NULL; // 主协程不需要堆栈(直接使用系统堆栈)
-    
+    co_table_init(&r->wait_table);
+    co_table_init(&r->run_table);
+    co_table_init(&r->dead_table);
+    r->seed = (unsigned int)(uintptr_t)r ^ (unsigned int)pthread_self();
+    r->handoff = NULL;
+    r->post_head = NULL;
+    r->post_defer = r->post_defer_tail = NULL;
+    r->idle = 0;
+    r->prof = NULL;
+    r->wd = NULL;
+    memset(&r->arena, 0, sizeof(r->arena));
+    r->post_live = 0;
+    r->chunk_cache = NULL;
+    r->chunk_cached = 0;
+    r->efd = eventfd(0, EFD_CLOEXEC);
+    if (r->efd < 0) {
+        panic("eventfd failed\n");
+    }
+
+    // 初始化主协程, 和普通协程不同的字段在 co_init 之后覆盖
+    co_init(&r->main_co, NULL, NULL, NULL);
+    r->main_co.name = "main";
+    r->main_co.status = CO_RUNNING;
+    r->main_co.stack = NULL; // 主协程不需要堆栈(直接使用系统堆栈)
+    r->main_co.stack_arena = 0;
+    r->main_co.runtime = r; // co_init 用的 co_rt 此时还不是 r
+
     // 设置当前协程为主协程
-    co_current = &main_co;
-    
+    r->current = &r->main_co;
+
     // 将主协程加入运行表
-    co_table_add(&co_run_table, &main_co);
-    debug("co_init done! %d\n", co_run_table.num);
+    co_table_add(&r->run_table, &r->main_co);
+
+    // 线程退出时由 pthread key 的析构函数回收
+    pthread_once(&co_rt_key_once, co_rt_key_init);
+    pthread_setspecific(co_rt_key, r);
+    debug("co_runtime_init done! %d\n", r->run_table.num);
+    return r;
+}
+
+// 第一次使用时才为当前线程创建 runtime
+static inline struct co_runtime *co_runtime_self() {
+    if (__builtin_expect(co_rt == NULL, 0)) {
+        co_rt = co_runtime_init();
+    }
+    return co_rt;
+}
+
+#define rt      (co_rt)
+#define current (co_rt->current)
+
+struct co_runtime *co_runtime_current() {
+    return co_runtime_self();
+}
+
+struct co *co_self() {
+    co_runtime_self();
+    return current;
+}
+
+// 可以在任意线程调用, 不加锁
+static void co_post_push(struct co_runtime *r, struct co_post_node *node) {
+    struct co_post_node *head = __atomic_load_n(&r->post_head, __ATOMIC_RELAXED);
+    do {
+        node->next = head;
+    } while (!__atomic_compare_exchange_n(&r->post_head, &head, node, 1,
+                                          __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+    // 与 co_idle_wait 配对: 要么 runtime 看到了 node, 要么这里看到了 idle
+    if (__atomic_load_n(&r->idle, __ATOMIC_SEQ_CST)) {
+        uint64_t one = 1;
+        ssize_t ret = write(r->efd, &one, sizeof(one));
+        (void)ret;
+    }
+}
+
+static struct co_post_node *co_post_node_new(enum co_post_kind kind) {
+    struct co_post_node *node = (struct co_post_node *)malloc(sizeof(struct co_post_node));
+    if (node == NULL) {
+        panic("malloc co_post_node failed\n");
+    }
+    node->kind = kind;
+    node->fn = NULL;
+    node->arg = NULL;
+    node->co = NULL;
+    return node;
+}
+
+void co_post(struct co_runtime *runtime, void (*fn)(void *), void *arg) {
+    struct co_post_node *node = co_post_node_new(CO_POST_FN);
+    node->fn = fn;
+    node->arg = arg;
+    co_post_push(runtime, node);
 }
 
+static void co_wake_local(struct co *co) {
+    if (co->status == CO_PARKED) {
+        co_table_del_co(&rt->wait_table, co);
+        co_table_add(&rt->run_table, co);
+        co->status = CO_RUNNING;
+    } else if (co->status != CO_DEAD) {
+        co->wake_pending = 1;
+    }
+}
+
+void co_wake_external(struct co *co) {
+    assert(!co->stackless);
+    if (co->runtime == co_rt) { // 同一线程不需要经过投递队列
+        co_wake_local(co);
+        return ;
+    }
+    struct co_post_node *node = co_post_node_new(CO_POST_WAKE);
+    node->co = co;
+    co_post_push(co->runtime, node);
+}
+
+// 只在 runtime 所属线程调用
+static void co_post_drain() {
+    struct co_post_node *node, *next;
+    if (__atomic_load_n(&rt->post_head, __ATOMIC_RELAXED) != NULL) {
+        node = __atomic_exchange_n(&rt->post_head, NULL, __ATOMIC_ACQUIRE);
+        // 栈是后进先出, 反转成投递顺序
+        struct co_post_node *fifo = NULL;
+        for (; node != NULL; node = next) {
+            next = node->next;
+            node->next = fifo;
+            fifo = node;
+        }
+        // 唤醒总是立即处理, 不能排在创建不了的协程后面;
+        //   否则存活的 co_post 协程都在等唤醒时谁也结束不了
+        for (node = fifo; node != NULL; node = next) {
+            next = node->next;
+            if (node->kind == CO_POST_FN) {
+                node->next = NULL;
+                if (rt->post_defer_tail) {
+                    rt->post_defer_tail->next = node;
+                } else {
+                    rt->post_defer = node;
+                }
+                rt->post_defer_tail = node;
+            } else {
+                co_wake_local(node->co);
+                free(node);
+            }
+        }
+    }
+    // 存活的太多了就留到有 co_post 协程结束之后
+    while (rt->post_defer != NULL && rt->post_live < CO_POST_MAX_LIVE) {
+        node = rt->post_defer;
+        rt->post_defer = node->next;
+        struct co *co = co_create("co_post", node->fn, node->arg, NULL);
+        co->detached = 1;
+        co->posted = 1;
+        rt->post_live++;
+        free(node);
+    }
+    if (rt->post_defer == NULL) {
+        rt->post_defer_tail = NULL;
+    }
+}
+
+// 没有可运行的协程时阻塞, 直到有其他线程投递
+static void co_idle_wait() {
+    __atomic_store_n(&rt->idle, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&rt->post_head, __ATOMIC_SEQ_CST) == NULL) {
+        uint64_t val;
+        while (read(rt->efd, &val, sizeof(val)) < 0 && errno == EINTR) ;
+    }
+    __atomic_store_n(&rt->idle, 0, __ATOMIC_RELAXED);
+}
+
+
+static void *co_region_map(size_t size, int *backing) {
+    // 不能带 MAP_NORESERVE, 否则大页池不够时要到访问时才 SIGBUS
+    void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (addr != MAP_FAILED) {
+        *backing = CO_ARENA_HUGETLB;
+        return addr;
+    }
+    // 没有预留大页, 多映射一个大页的大小用来对齐, 再交给 THP
+    uint8_t *raw = (uint8_t *)mmap(NULL, size + CO_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (raw == MAP_FAILED) {
+        return NULL;
+    }
+    uint8_t *aligned = (uint8_t *)(((uintptr_t)raw + CO_HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(CO_HUGE_PAGE_SIZE - 1));
+    if (aligned > raw) {
+        munmap(raw, aligned - raw);
+    }
+    munmap(aligned + size, raw + CO_HUGE_PAGE_SIZE - aligned);
+    *backing = madvise(aligned, size, MADV_HUGEPAGE) == 0 ? CO_ARENA_THP : CO_ARENA_NORMAL;
+    return aligned;
+}
 
-void co_schedule() {
-    // random select a co from co_run_table
-    int idx = rand() % co_run_table.num;
-    current = co_run_table.tab[idx];
+static int co_arena_grow(struct co_stack_arena *arena) {
+    struct co_stack_region *region = (struct co_stack_region *)malloc(sizeof(struct co_stack_region));
+    if (region == NULL) {
+        return -1;
+    }
+    int backing;
+    uint8_t *base = (uint8_t *)co_region_map(arena->region_size, &backing);
+    if (base == NULL) {
+        free(region);
+        return -1;
+    }
+    if (arena->numa_node >= 0) {
+        unsigned long mask[16] = {0};
+        unsigned long bits = 8 * sizeof(unsigned long);
+        if ((size_t)arena->numa_node < sizeof(mask) * 8) {
+            mask[arena->numa_node / bits] = 1UL << (arena->numa_node % bits);
+            // 失败时 (单节点机器或内核不支持) 就不绑定了
+            syscall(SYS_mbind, base, arena->region_size, CO_MPOL_BIND, mask, sizeof(mask) * 8, 0);
+        }
+    }
+    region->base = base;
+    region->size = arena->region_size;
+    region->next = arena->regions;
+    arena->regions = region;
+    arena->backing = backing;
+    arena->cur = base;
+    arena->end = base + arena->region_size;
+    return 0;
+}
+
+int co_stack_arena(size_t region_size, int numa_node) {
+    co_runtime_self();
+    struct co_stack_arena *arena = &rt->arena;
+    if (arena->enabled) {
+        return arena->backing;
+    }
+    if (region_size == 0) {
+        region_size = CO_ARENA_REGION_SIZE;
+    }
+    // region 按大页对齐, 至少放得下一个栈
+    region_size = (region_size + CO_HUGE_PAGE_SIZE - 1) & ~(size_t)(CO_HUGE_PAGE_SIZE - 1);
+    arena->region_size = region_size;
+    arena->numa_node = numa_node;
+    if (co_arena_grow(arena) != 0) {
+        return -1;
+    }
+    arena->enabled = 1;
+    return arena->backing;
+}
+
+static void co_stack_alloc(struct co *co) {
+    struct co_stack_arena *arena = &rt->arena;
+    co->stack_arena = 0;
+#ifdef CO_SPLIT_STACK
+    co->stack = (uint8_t *)__splitstack_makecontext(CO_STACK_SIZE, co->split_context, &co->split_size);
+    if (co->stack == NULL) {
+        panic("__splitstack_makecontext failed\n");
+    }
+    return ;
+#endif
+    if (!arena->enabled) {
+        co->stack = (uint8_t *)malloc(CO_STACK_SIZE);
+        if (co->stack == NULL) {
+            panic("malloc stack failed\n");
+        }
+#ifdef DEBUG
+        memset(co->stack, 0x5f, CO_STACK_SIZE); // for debuging
+#endif
+        return ;
+    }
+    if (arena->free_list) {
+        uint8_t *stack = (uint8_t *)arena->free_list - CO_STACK_SIZE;
+        arena->free_list = *(void **)((uint8_t *)arena->free_list - sizeof(void *));
+        co->stack = stack;
+    } else {
+        if (arena->cur + CO_STACK_SIZE > arena->end && co_arena_grow(arena) != 0) {
+            panic("mmap stack arena failed\n");
+        }
+        co->stack = arena->cur;
+        arena->cur += CO_STACK_SIZE;
+    }
+    co->stack_arena = 1;
+}
+
+static void co_stack_release(struct co *co) {
+    if (co->stack == NULL) {
+        return ;
+    }
+#ifdef CO_SPLIT_STACK
+    // 释放的是整个栈段链表, 不能是正在运行的协程 (见 co_runtime_destroy)
+    __splitstack_releasecontext(co->split_context);
+    co->stack = NULL;
+    return ;
+#endif
+    // co_start_batch 的栈在整批结束后由 co_dead_handle 一起归还
+    if (co->batch) {
+        co->stack = NULL;
+        return ;
+    }
+    if (co->stack_arena) {
+        // 栈顶总是已经被访问过, 把链表指针放在那里不会多碰一个页
+        uint8_t *top = co->stack + CO_STACK_SIZE;
+        *(void **)(top - sizeof(void *)) = rt->arena.free_list;
+        rt->arena.free_list = top;
+    } else {
+        free(co->stack);
+    }
+    co->stack = NULL;
+}
+
+// keep 所在的区域不解除映射 (co_runtime_destroy 时可能还运行在上面), 只释放描述
+static void co_stack_arena_free(struct co_stack_arena *arena, const uint8_t *keep) {
+    struct co_stack_region *region, *next;
+    for (region = arena->regions; region != NULL; region = next) {
+        next = region->next;
+        if (keep < region->base || keep >= region->base + region->size) {
+            munmap(region->base, region->size);
+        }
+        free(region);
+    }
+    memset(arena, 0, sizeof(*arena));
+}
+
+static void co_wd_record(struct co_watchdog *wd, int kind, struct co *co, uint64_t delta) {
+    uint64_t ns = (uint64_t)(delta * wd->ns_per_tsc);
+    int bucket = ns ? 63 - __builtin_clzll(ns) : 0;
+    wd->hist[kind][bucket < CO_WD_BUCKETS ? bucket : CO_WD_BUCKETS - 1]++;
+    uint64_t limit = kind == CO_WD_SLICE ? wd->slice_tsc : wd->wait_tsc;
+    if (limit == 0 || delta <= limit) {
+        return ;
+    }
+    if (wd->fn) {
+        wd->fn(co->name, kind, ns, wd->arg);
+    } else {
+        fprintf(stderr, "co_watchdog: %s %s %.3f ms\n", co->name,
+                kind == CO_WD_SLICE ? "ran without yielding for" : "runnable but not picked for", ns / 1e6);
+    }
+}
+
+// current 被换出: 记录运行时长, 仍可运行时重新开始计算等待时间
+static void co_wd_out(struct co_watchdog *wd) {
+    if (wd->in == 0) {
+        return ;
+    }
+    uint64_t now = co_rdtsc();
+    co_wd_record(wd, CO_WD_SLICE, current, now - wd->in);
+    wd->in = 0;
+    wd->out = now;
+    if (current->status == CO_RUNNING) {
+        rt->run_table.stamp[current->idx] = now;
+    }
+}
+
+// current 刚被选中: 记录它等了多久
+//   换出到换入之间只有选择的开销, 直接用换出的时间, 每次切换只读一次 TSC
+static void co_wd_in(struct co_watchdog *wd) {
+    uint64_t now = wd->out ? wd->out : co_rdtsc();
+    uint64_t ready = rt->run_table.stamp[current->idx];
+    co_wd_record(wd, CO_WD_WAIT, current, now > ready ? now - ready : 0);
+    wd->in = now;
+}
+
+// 新协程开始执行时的栈顶, co_start_inline 的参数在它上面
+static inline void *co_stack_top(struct co *co) {
+#ifdef CO_SPLIT_STACK
+    // 栈下限是按段的实际大小算的, 段也不保证 16 字节对齐
+    uintptr_t top = ((uintptr_t)co->stack + co->split_size) & ~(uintptr_t)15;
+#else
+    uintptr_t top = (uintptr_t)co->stack + CO_STACK_SIZE;
+#endif
+    return (void *)(top - co->stack_inline);
+}
+
+CO_NO_SPLIT void co_schedule() {
+    if (__builtin_expect(rt->wd != NULL, 0)) {
+        co_wd_out(rt->wd);
+    }
+    // 先判断再调用, 队列为空时不进入 co_post_drain
+    if (__atomic_load_n(&rt->post_head, __ATOMIC_RELAXED) ||
+        (rt->post_defer && rt->post_live < CO_POST_MAX_LIVE)) {
+        co_post_drain();
+    }
+    while (rt->run_table.num == 0) {
+        if (rt->wd) {
+            rt->wd->out = 0;
+        }
+        co_idle_wait();
+        co_post_drain();
+    }
+    if (rt->handoff) {
+        // co_yield_to 已经确认它在 run_table 中, 投递只会增加协程, 不会移走它
+        current = rt->handoff;
+        rt->handoff = NULL;
+    } else {
+        // random select a co from run_table
+        int idx = rand_r(&rt->seed) % rt->run_table.num;
+        current = rt->run_table.tab[idx];
+    }
     assert(current != NULL);
     debug("co_schedule: %s\n", current->name);
+    if (__builtin_expect(rt->wd != NULL, 0)) {
+        co_wd_in(rt->wd);
+    }
+    if (current->stackless) {
+        // 每一步都从 runtime 栈顶开始, 不需要保存任何现场
+#ifdef CO_SPLIT_STACK
+        co_split_guard_clear();
+#endif
+        stack_switch_call(rt->stack + CO_RUNTIME_STACK_SIZE, co_sl_step, (uintptr_t)current);
+    }
+#ifdef CO_SPLIT_STACK
+    __splitstack_setcontext(current->split_context);
+#endif
     if (current->status == CO_NEW) {
         debug("co_schedule: %s -> start\n", current->name);
-        stack_switch_call(current->stack + CO_STACK_SIZE, co_wrapper, (uintptr_t)current);
+        stack_switch_call(co_stack_top(current), co_wrapper, (uintptr_t)current);
     } else if (current->status == CO_RUNNING) {
         debug("co_schedule: %s -> resume\n", current->name);
         longjmp(current->context, 1);
@@ -163,33 +797,332 @@ void co_schedule() {
     // longjmp(current->context, 1);
 }
 
-void co_dead_handle(struct co *co) {
-    struct co_list_node *entry, *tmp;
-    co->status = CO_DEAD;
-    free(co->stack); // 释放堆栈
-    co->stack = NULL;
-    co_table_del_co(&co_run_table, co);
-    co_table_add(&co_dead_table, co);
+// 所有线程共享的空闲块, 只在 runtime 的缓存空了或满了时整批存取
+static struct {
+    pthread_mutex_t lock;
+    struct co_chunk *head;
+    int num;
+} co_chunk_pool = { PTHREAD_MUTEX_INITIALIZER, NULL, 0 };
 
+static struct co_chunk *co_chunk_get() {
+    if (rt->chunk_cache == NULL && __atomic_load_n(&co_chunk_pool.head, __ATOMIC_RELAXED)) {
+        pthread_mutex_lock(&co_chunk_pool.lock);
+        while (co_chunk_pool.head && rt->chunk_cached < CO_CHUNK_CACHE / 2) {
+            struct co_chunk *chunk = co_chunk_pool.head;
+            co_chunk_pool.head = chunk->next;
+            co_chunk_pool.num--;
+            chunk->next = rt->chunk_cache;
+            rt->chunk_cache = chunk;
+            rt->chunk_cached++;
+        }
+        pthread_mutex_unlock(&co_chunk_pool.lock);
+    }
+    struct co_chunk *chunk = rt->chunk_cache;
+    if (chunk) {
+        rt->chunk_cache = chunk->next;
+        rt->chunk_cached--;
+        return chunk;
+    }
+    chunk = (struct co_chunk *)malloc(sizeof(struct co_chunk) + CO_CHUNK_SIZE);
+    if (chunk == NULL) {
+        panic("malloc co_chunk failed\n");
+    }
+    chunk->size = CO_CHUNK_SIZE;
+    return chunk;
+}
+
+// 缓存中超过 keep 个的块还给全局池, 全局池也满了就释放
+static void co_chunk_flush(struct co_runtime *r, int keep) {
+    if (r->chunk_cached <= keep) {
+        return ;
+    }
+    pthread_mutex_lock(&co_chunk_pool.lock);
+    while (r->chunk_cached > keep) {
+        struct co_chunk *chunk = r->chunk_cache;
+        r->chunk_cache = chunk->next;
+        r->chunk_cached--;
+        if (co_chunk_pool.num < CO_CHUNK_POOL_MAX) {
+            chunk->next = co_chunk_pool.head;
+            co_chunk_pool.head = chunk;
+            co_chunk_pool.num++;
+        } else {
+            free(chunk);
+        }
+    }
+    pthread_mutex_unlock(&co_chunk_pool.lock);
+}
+
+// 协程结束时一次性归还 co_alloc 的所有内存
+static void co_region_release(struct co *co) {
+    struct co_chunk *chunk, *next;
+    for (chunk = co->region; chunk != NULL; chunk = next) {
+        next = chunk->next;
+        if (chunk->size != CO_CHUNK_SIZE) {
+            free(chunk);
+            continue;
+        }
+        chunk->next = rt->chunk_cache;
+        rt->chunk_cache = chunk;
+        rt->chunk_cached++;
+    }
+    co->region = NULL;
+    co->region_cur = co->region_end = NULL;
+    co_chunk_flush(rt, CO_CHUNK_CACHE);
+}
+
+static void *co_alloc_slow(struct co *co, size_t size) {
+    struct co_chunk *chunk;
+    if (size > CO_CHUNK_SIZE / 4) {
+        // 大块单独分配, 不打断当前块的分配
+        chunk = (struct co_chunk *)malloc(sizeof(struct co_chunk) + size);
+        if (chunk == NULL) {
+            return NULL;
+        }
+        chunk->size = size;
+        chunk->next = co->region;
+        co->region = chunk;
+        return chunk + 1;
+    }
+    chunk = co_chunk_get();
+    chunk->next = co->region;
+    co->region = chunk;
+    co->region_cur = (uint8_t *)(chunk + 1) + size;
+    co->region_end = (uint8_t *)(chunk + 1) + CO_CHUNK_SIZE;
+    return chunk + 1;
+}
+
+void *co_alloc(size_t size) {
+    co_runtime_self();
+    struct co *co = current;
+    assert(!co->stackless);
+    size = (size + 15) & ~(size_t)15;
+    if (__builtin_expect((size_t)(co->region_end - co->region_cur) >= size, 1)) {
+        void *ptr = co->region_cur;
+        co->region_cur += size;
+        return ptr;
+    }
+    return co_alloc_slow(co, size);
+}
+
+// co 已结束: 唤醒所有 co_wait 它的协程
+static void co_wake_waiters(struct co *co) {
+    struct co_list_node *entry, *tmp;
     list_for_each_entry_safe(entry, tmp, &co->waiters, node) {
-        co_table_del_co(&co_wait_table, entry->co);
-        co_table_add(&co_run_table, entry->co);
+        co_table_del_co(&rt->wait_table, entry->co);
+        co_table_add(&rt->run_table, entry->co);
         list_del(&entry->node);
         entry->co->status = CO_RUNNING;
+        if (!entry->co->stackless) {
+            entry->co->wait_node = NULL;
+        }
         free(entry);
     }
+}
+
+// 没有 detach 的放进 dead_table, 等线程退出或 co_detach 时释放
+static void co_finish(struct co *co) {
+    co_table_add(&rt->dead_table, co);
+    co_wake_waiters(co);
+}
+
+void co_dead_handle(struct co *co) {
+    co->status = CO_DEAD;
+    if (rt->wd) {
+        co_wd_out(rt->wd); // co 可能马上被释放, 不能留到 co_schedule
+    }
+    // 已经在 runtime 栈上, 不再让 SIGPROF 采样读到马上要释放的 co
+    current = &rt->main_co;
+    co_stack_release(co); // 释放堆栈
+    co_region_release(co);
+    co_table_del_co(&rt->run_table, co);
+
+    // 子协程交给父协程, 保持子树关系
+    struct co *child, *ctmp;
+    list_for_each_entry_safe(child, ctmp, &co->children, sibling) {
+        list_del(&child->sibling);
+        child->parent = co->parent;
+        if (co->parent) {
+            list_add_tail(&child->sibling, &co->parent->children);
+        } else {
+            INIT_LIST_HEAD(&child->sibling);
+        }
+    }
+    if (co->parent) {
+        list_del_init(&co->sibling);
+        co->parent = NULL;
+    }
+
+    struct co_batch *batch = co->batch;
+    if (batch && --batch->alive == 0) {
+        if (batch->stack_size) {
+            munmap((uint8_t *)batch + batch->ctrl_size, batch->stack_size);
+            batch->stack_size = 0;
+        }
+        struct co *joiner = batch->joiner;
+        if (joiner && joiner->status == CO_WAITING) {
+            co_table_del_co(&rt->wait_table, joiner);
+            co_table_add(&rt->run_table, joiner);
+            joiner->status = CO_RUNNING;
+        }
+    }
+
+    if (co->detached) {
+        if (co->posted) {
+            rt->post_live--;
+        }
+        co_wake_waiters(co); // detach 之前已经开始等待的
+        co_free(co);
+        co_schedule();
+    }
+    co_finish(co);
+    co_schedule();
+}
+
+// 在 runtime 栈上执行无栈协程的一步, 然后继续调度
+static void co_sl_step(struct co *co) {
+    co->status = CO_RUNNING;
+    int ret = ((co_sl_func)co->func)(&co->pc, (uint8_t *)co + CO_SL_HEAD);
+    if (ret == CO_SL_DONE) {
+        co->status = CO_DEAD;
+        if (rt->wd) {
+            co_wd_out(rt->wd); // 和 co_dead_handle 一样, 释放之前记录
+        }
+        current = &rt->main_co;
+        co_table_del_co(&rt->run_table, co);
+        if (co->stackless == CO_SL_DETACHED) {
+            co_wake_waiters(co);
+            free(co);
+        } else {
+            co_finish(co);
+        }
+    }
+    // CO_SL_BLOCKED: co_sl_wait 已经把它移到 wait_table
     co_schedule();
 }
 
+// key 在所有线程间共享, 和 pthread_key_t 一样
+static void (*co_key_dtors[CO_KEY_MAX])(void *);
+static int co_key_num;
+
+int co_key_create(void (*dtor)(void *)) {
+    int key = __atomic_fetch_add(&co_key_num, 1, __ATOMIC_RELAXED);
+    if (key >= CO_KEY_MAX) {
+        __atomic_fetch_sub(&co_key_num, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+    co_key_dtors[key] = dtor;
+    return key;
+}
+
+static inline void **co_specific_slot(struct co *co, int key) {
+    if (__builtin_expect(key < CO_KEY_INLINE, 1)) {
+        return &co->specific[key];
+    }
+    if (co->specific_ext == NULL) {
+        co->specific_ext = (void **)calloc(CO_KEY_MAX - CO_KEY_INLINE, sizeof(void *));
+        if (co->specific_ext == NULL) {
+            panic("malloc specific_ext failed\n");
+        }
+    }
+    return &co->specific_ext[key - CO_KEY_INLINE];
+}
+
+void *co_getspecific(int key) {
+    co_runtime_self();
+    assert(!current->stackless); // 无栈协程只有 CO_SL_HEAD, 没有后面的字段
+    assert(key >= 0 && key < CO_KEY_MAX);
+    if (__builtin_expect(key < CO_KEY_INLINE, 1)) {
+        return current->specific[key];
+    }
+    void **ext = current->specific_ext;
+    return ext ? ext[key - CO_KEY_INLINE] : NULL;
+}
+
+void co_setspecific(int key, const void *value) {
+    co_runtime_self();
+    assert(!current->stackless);
+    assert(key >= 0 && key < CO_KEY_MAX);
+    *co_specific_slot(current, key) = (void *)value;
+}
+
+// 和 pthread 一样, 析构函数里可能重新设置值, 最多重复几轮
+static void co_specific_run(struct co *co) {
+    int num = __atomic_load_n(&co_key_num, __ATOMIC_RELAXED);
+    for (int iter = 0; iter < CO_KEY_DTOR_ITERATIONS; iter++) {
+        int called = 0;
+        for (int key = 0; key < num; key++) {
+            if (key >= CO_KEY_INLINE && co->specific_ext == NULL) {
+                break;
+            }
+            void **slot = co_specific_slot(co, key);
+            void *value = *slot;
+            if (value && co_key_dtors[key]) {
+                *slot = NULL;
+                co_key_dtors[key](value);
+                called = 1;
+            }
+        }
+        if (!called) {
+            break;
+        }
+    }
+}
+
+static void co_cleanup_run(struct co *co) {
+    while (co->cleanup) {
+        struct co_cleanup *c = co->cleanup;
+        co->cleanup = c->next;
+        c->fn(c->arg);
+        free(c);
+    }
+}
+
 void co_wrapper(struct co *co) {
     co->status = CO_RUNNING;
     debug("co_wrapper: %s\n", co->name);
-    co->func(co->arg);
-    stack_switch_call(co_runtime_stack + CO_RUNTIME_STACK_SIZE, co_dead_handle, (uintptr_t)co);
+    // 还没运行就被取消了, 直接结束; co_start_inline 的参数需要 func 析构, 仍然调用
+    if (!co->canceled || co->stack_inline) {
+        co->func(co->arg);
+    }
+    co_cleanup_run(co);
+    co_specific_run(co); // 在协程自己的栈上执行, runtime 栈很小
+#ifdef CO_SPLIT_STACK
+    co_split_guard_clear();
+#endif
+    stack_switch_call(rt->stack + CO_RUNTIME_STACK_SIZE, co_dead_handle, (uintptr_t)co);
 }
 
 
-struct co *co_start(const char *name, void (*func)(void *), void *arg) {
+static void co_init(struct co *co, void (*func)(void *), void *arg, struct co *parent) {
+    co->func = func;
+    co->arg = arg;
+    memset(co->specific, 0, sizeof(co->specific));
+    co->specific_ext = NULL;
+    co->status = CO_NEW;
+    co->stackless = 0;
+    co->pc = 0;
+    INIT_LIST_HEAD(&co->waiters);
+    co->runtime = rt;
+    co->detached = 0;
+    co->posted = 0;
+    co->wake_pending = 0;
+    co->canceled = 0;
+    co->wait_node = NULL;
+    co->cleanup = NULL;
+    co->parent = parent;
+    INIT_LIST_HEAD(&co->children);
+    if (parent) {
+        list_add_tail(&co->sibling, &parent->children);
+    } else {
+        INIT_LIST_HEAD(&co->sibling);
+    }
+    co->batch = NULL;
+    co->stack_inline = 0;
+    co->region = NULL;
+    co->region_cur = co->region_end = NULL;
+}
+
+static struct co *co_create(const char *name, void (*func)(void *), void *arg, struct co *parent) {
     struct co *co = (struct co *)malloc(sizeof(struct co));
     debug("co_start: %s\n", name);
     if (co == NULL) {
@@ -203,80 +1136,742 @@ struct co *co_start(const char *name, void (*func)(void *), void *arg) {
         return NULL;
     }
     strcpy(co->name, name);
-    co->func = func;
-    co->arg = arg;
-    co->status = CO_NEW;
-    INIT_LIST_HEAD(&co->waiters);
-    co->stack = (uint8_t *)malloc(CO_STACK_SIZE);
-    if (co->stack == NULL) {
-        panic("malloc stack failed\n");
-        return NULL;
-    }
-    
-    co_table_add(&co_run_table, co);
+    co_init(co, func, arg, parent);
+    co_stack_alloc(co);
 
-    memset(co->stack, 0x5f, CO_STACK_SIZE); // for debuging
+    co_table_add(&rt->run_table, co);
     debug("co_start: %s, stack: %p\n", name, co->stack);
     return co;
 }
 
-void co_wait(struct co *co) {
+// 无栈协程没有 children 链表, 在其中创建的协程不属于任何子树
+static inline struct co *co_parent() {
+    return current->stackless ? NULL : current;
+}
+
+struct co *co_start(const char *name, void (*func)(void *), void *arg) {
+    co_runtime_self();
+    return co_create(name, func, arg, co_parent());
+}
+
+struct co *co_start_inline(const char *name, void (*func)(void *), size_t arg_size, void **arg) {
+    co_runtime_self();
+    assert(arg_size <= CO_INLINE_MAX);
+    struct co *co = co_create(name, func, NULL, co_parent());
+    // 至少保留 16 字节, stack_inline 非 0 就表示由 co_start_inline 创建
+    co->stack_inline = arg_size ? (arg_size + 15) & ~(size_t)15 : 16;
+    co->arg = co_stack_top(co);
+    *arg = co->arg;
+    return co;
+}
+
+int co_start_batch(const char *name, void (*func)(void *), void *args[], int n, struct co *out_cos[]) {
+    co_runtime_self();
+    if (n <= 0) {
+        return -1;
+    }
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t name_len = strlen(name) + 1;
+    size_t cos_off = (sizeof(struct co_batch) + 63) & ~(size_t)63;
+    size_t ctrl_size = (cos_off + n * sizeof(struct co) + name_len + page - 1) & ~(page - 1);
+#ifdef CO_SPLIT_STACK
+    size_t stack_size = 0; // 每个协程单独的栈段
+#else
+    size_t stack_size = (size_t)n * CO_STACK_SIZE;
+#endif
+    // 栈只在协程运行时才被访问, 映射时不占物理内存
+    uint8_t *base = (uint8_t *)mmap(NULL, ctrl_size + stack_size, PROT_READ | PROT_WRITE,
+                                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) {
+        return -1;
+    }
+    struct co_batch *batch = (struct co_batch *)base;
+    struct co *cos = (struct co *)(base + cos_off);
+    char *co_name = (char *)(cos + n);
+    uint8_t *stacks = base + ctrl_size;
+    memcpy(co_name, name, name_len);
+    batch->ctrl_size = ctrl_size;
+    batch->stack_size = stack_size;
+    batch->num = batch->alive = batch->refs = n;
+    batch->joiner = NULL;
+
+    co_table_reserve(&rt->run_table, n);
+    for (int i = 0; i < n; i++) {
+        struct co *co = &cos[i];
+        co->name = co_name;
+        co_init(co, func, args ? args[i] : NULL, co_parent());
+#ifdef CO_SPLIT_STACK
+        co_stack_alloc(co);
+        (void)stacks;
+#else
+        co->stack = stacks + (size_t)i * CO_STACK_SIZE;
+        co->stack_arena = 0;
+#endif
+        co->batch = batch;
+        co->idx = rt->run_table.num + i;
+        rt->run_table.tab[co->idx] = co;
+        if (out_cos) {
+            out_cos[i] = co;
+        }
+    }
+    if (rt->run_table.stamp) {
+        uint64_t now = co_rdtsc();
+        for (int i = 0; i < n; i++) {
+            rt->run_table.stamp[rt->run_table.num + i] = now;
+        }
+    }
+    rt->run_table.num += n;
+    debug("co_start_batch: %s x %d, base: %p\n", name, n, base);
+    return 0;
+}
+
+struct co *co_start_sl(const char *name, co_sl_func func, const void *frame, size_t frame_size) {
+    co_runtime_self();
+    struct co *co = (struct co *)malloc(CO_SL_HEAD + frame_size);
+    if (co == NULL) {
+        panic("malloc stackless co failed\n");
+    }
+    co->name = (char *)name;
+    co->func = (void (*)(void *))func;
+    INIT_LIST_HEAD(&co->waiters);
+    co->status = CO_NEW;
+    co->stackless = 1;
+    co->pc = 0;
+    if (frame) {
+        memcpy((uint8_t *)co + CO_SL_HEAD, frame, frame_size);
+    } else {
+        memset((uint8_t *)co + CO_SL_HEAD, 0, frame_size);
+    }
+    co_table_add(&rt->run_table, co);
+    return co;
+}
+
+// 由 CO_SL_AWAIT 在无栈协程中调用, 返回 1 表示需要让出
+int co_sl_wait(struct co *co) {
+    co_runtime_self();
+    assert(current->stackless);
+    if (co->status == CO_DEAD) {
+        return 0;
+    }
+    struct co_list_node *node = (struct co_list_node *)malloc(sizeof(struct co_list_node));
+    if (node == NULL) {
+        panic("malloc co_list_node failed\n");
+    }
+    node->co = current;
+    list_add(&node->node, &co->waiters);
+    current->status = CO_WAITING;
+    co_table_del_co(&rt->run_table, current);
+    co_table_add(&rt->wait_table, current);
+    return 1;
+}
+
+// 保存当前上下文并切换到其他协程
+CO_NO_SPLIT static void co_switch() {
+    // 无栈协程没有 context, 只能通过 CO_SL_* 宏让出
+    assert(!current->stackless);
+#ifdef CO_SPLIT_STACK
+    __splitstack_getcontext(current->split_context);
+#endif
+    int val = setjmp(current->context);
+    if (val == 0) { // 保存当前上下文
+        co_schedule();
+    } else { // 恢复上下文
+        return ;
+    }
+}
+
+int co_wait(struct co *co) {
+    co_runtime_self();
+    assert(!current->stackless);
     debug("co_wait: %s (%s)\n", co->name, current->name);
+    if (current->canceled) {
+        return CO_CANCELED;
+    }
     if (co->status == CO_DEAD) {
         debug("co_wait: %s (%s) -> return\n", co->name, current->name);
-        return ;
+        return 0;
     }
     current->status = CO_WAITING;
     struct co_list_node *node = (struct co_list_node *)malloc(sizeof(struct co_list_node));
     if (node == NULL) {
         panic("malloc co_list_node failed\n");
-        return ;
+        return 0;
     }
     node->co = current;
     list_add(&node->node, &co->waiters);
+    current->wait_node = node;
 
-    co_table_del_co(&co_run_table, current);
-    co_table_add(&co_wait_table, current);
+    co_table_del_co(&rt->run_table, current);
+    co_table_add(&rt->wait_table, current);
     debug("co_wait: %s (%s) -> yield\n", co->name, current->name);
-    co_yield();
+    co_switch();
+    return current->canceled ? CO_CANCELED : 0;
+}
+
+int co_wait_batch(struct co *cos[], int n) {
+    co_runtime_self();
+    assert(!current->stackless);
+    if (current->canceled) {
+        return CO_CANCELED;
+    }
+    if (n <= 0) {
+        return 0;
+    }
+    // 恰好是同一批的全部协程时, 只需要在批次上等一次
+    struct co_batch *batch = cos[0]->stackless ? NULL : cos[0]->batch;
+    for (int i = 1; batch && i < n; i++) {
+        if (cos[i]->stackless || cos[i]->batch != batch) {
+            batch = NULL;
+        }
+    }
+    if (batch && batch->num == n && batch->joiner == NULL) {
+        if (batch->alive == 0) {
+            return 0;
+        }
+        batch->joiner = current;
+        current->status = CO_WAITING;
+        co_table_del_co(&rt->run_table, current);
+        co_table_add(&rt->wait_table, current);
+        co_switch();
+        batch->joiner = NULL;
+        return current->canceled ? CO_CANCELED : 0;
+    }
+    for (int i = 0; i < n; i++) {
+        if (co_wait(cos[i]) == CO_CANCELED) {
+            return CO_CANCELED;
+        }
+    }
+    return 0;
 }
 
-void co_yield() {
+int co_park() {
+    co_runtime_self();
+    assert(!current->stackless);
+    if (current->canceled) {
+        return CO_CANCELED;
+    }
+    if (current->wake_pending) {
+        current->wake_pending = 0;
+        return 0;
+    }
+    current->status = CO_PARKED;
+    co_table_del_co(&rt->run_table, current);
+    co_table_add(&rt->wait_table, current);
+    co_switch();
+    return current->canceled ? CO_CANCELED : 0;
+}
+
+int co_yield() {
+    co_runtime_self();
+    assert(!current->stackless);
     debug("co_yield: %s\n", current->name);
-    int val = setjmp(current->context);
-    if (val == 0) { // 保存当前上下文
-        co_schedule();
-    } else { // 恢复上下文
+    if (current->canceled) {
+        return CO_CANCELED;
+    }
+    co_switch();
+    return current->canceled ? CO_CANCELED : 0;
+}
+
+// 直接切换到 co, 不经过随机选择; co 不在当前线程的运行表中时等同于 co_yield
+int co_yield_to(struct co *co) {
+    co_runtime_self();
+    assert(!current->stackless);
+    debug("co_yield_to: %s -> %s\n", current->name, co->name);
+    if (current->canceled) {
+        return CO_CANCELED;
+    }
+    struct co_table *table = &rt->run_table;
+    if (co != current && co->idx < table->num && table->tab[co->idx] == co) {
+        rt->handoff = co;
+    }
+    co_switch();
+    return current->canceled ? CO_CANCELED : 0;
+}
+
+void co_detach(struct co *co) {
+    co_runtime_self();
+    assert(co->stackless || (co->runtime == rt && co != &rt->main_co));
+    if (co->status == CO_DEAD) {
+        co_table_del_co(&rt->dead_table, co);
+        co_free(co);
+    } else if (co->stackless) {
+        co->stackless = CO_SL_DETACHED;
+    } else {
+        co->detached = 1;
+    }
+}
+
+void co_cancel(struct co *co) {
+    co_runtime_self();
+    if (co->stackless) { // 无栈协程不支持取消
+        return ;
+    }
+    assert(co->runtime == rt);
+    if (co->status == CO_DEAD || co->canceled) {
+        return ;
+    }
+    debug("co_cancel: %s\n", co->name);
+    co->canceled = 1;
+    if (co->status == CO_WAITING && co->wait_node) { // co_wait_batch 没有 wait_node
+        list_del(&co->wait_node->node);
+        free(co->wait_node);
+        co->wait_node = NULL;
+    }
+    if (co->status == CO_WAITING || co->status == CO_PARKED) {
+        co_table_del_co(&rt->wait_table, co);
+        co_table_add(&rt->run_table, co);
+        co->status = CO_RUNNING;
+    }
+}
+
+void co_cancel_tree(struct co *co) {
+    struct co *child;
+    co_cancel(co);
+    if (co->stackless) { // 没有 children 链表
+        return ;
+    }
+    list_for_each_entry(child, &co->children, sibling) {
+        co_cancel_tree(child);
+    }
+}
+
+int co_canceled() {
+    co_runtime_self();
+    assert(!current->stackless);
+    return current->canceled;
+}
+
+void co_cleanup_push(void (*fn)(void *), void *arg) {
+    co_runtime_self();
+    assert(!current->stackless);
+    struct co_cleanup *c = (struct co_cleanup *)malloc(sizeof(struct co_cleanup));
+    if (c == NULL) {
+        panic("malloc co_cleanup failed\n");
+    }
+    c->fn = fn;
+    c->arg = arg;
+    c->next = current->cleanup;
+    current->cleanup = c;
+}
+
+void co_cleanup_pop(int execute) {
+    co_runtime_self();
+    assert(!current->stackless);
+    struct co_cleanup *c = current->cleanup;
+    assert(c != NULL);
+    current->cleanup = c->next;
+    if (execute) {
+        c->fn(c->arg);
+    }
+    free(c);
+}
+
+// SIGPROF 处理函数, 只能做 async-signal-safe 的事情
+CO_NO_SPLIT static void co_prof_handler(int sig, siginfo_t *info, void *ucontext) {
+    struct co_runtime *r = co_rt;
+    if (r == NULL || r->prof == NULL) {
+        return ;
+    }
+    struct co_prof *prof = r->prof;
+    if (prof->num >= CO_PROF_SAMPLES) {
+        prof->dropped++;
+        return ;
+    }
+    struct co_prof_sample *sample = &prof->samples[prof->num];
+    struct co *co = current;
+    ucontext_t *uc = (ucontext_t *)ucontext;
+
+    int i = 0;
+    for (; i < CO_PROF_NAME - 1 && co->name[i]; i++) {
+        sample->name[i] = co->name[i];
+    }
+    sample->name[i] = '\0';
+
+#if __x86_64__
+    uintptr_t pc = uc->uc_mcontext.gregs[REG_RIP];
+    uintptr_t fp = uc->uc_mcontext.gregs[REG_RBP];
+#else
+    uintptr_t pc = uc->uc_mcontext.gregs[REG_EIP];
+    uintptr_t fp = uc->uc_mcontext.gregs[REG_EBP];
+#endif
+    // 只在当前协程自己的栈范围内沿着帧指针回溯
+    uintptr_t lo, hi;
+    if (co == &r->main_co) {
+        lo = prof->main_lo;
+        hi = prof->main_hi;
+    } else if (co->stackless) { // 在 runtime 栈上执行
+        lo = (uintptr_t)r->stack;
+        hi = lo + CO_RUNTIME_STACK_SIZE;
+    } else if (co->stack) {
+        lo = (uintptr_t)co->stack;
+#ifdef CO_SPLIT_STACK
+        hi = lo + co->split_size;
+#else
+        hi = lo + CO_STACK_SIZE;
+#endif
+    } else {
+        lo = hi = 0;
+    }
+    int depth = 0;
+    sample->pc[depth++] = pc;
+    while (depth < CO_PROF_DEPTH) {
+        if (fp < lo || fp + 2 * sizeof(uintptr_t) > hi || fp % sizeof(uintptr_t)) {
+            break;
+        }
+        uintptr_t next = ((uintptr_t *)fp)[0];
+        uintptr_t ret = ((uintptr_t *)fp)[1];
+        if (next == 0 || ret == 0) { // 最外层的帧, 返回地址无意义
+            break;
+        }
+        sample->pc[depth++] = ret;
+        if (next <= fp) {
+            break;
+        }
+        fp = next;
+    }
+    sample->depth = depth;
+    prof->num++;
+}
+
+// SIGPROF 的处理函数是进程共享的: 第一个开始采样的线程安装, 最后一个停止的恢复原来的
+static struct {
+    pthread_mutex_t lock;
+    int users;
+    struct sigaction old;
+} co_prof_sig = { PTHREAD_MUTEX_INITIALIZER, 0 };
+
+static void co_prof_handler_get() {
+    pthread_mutex_lock(&co_prof_sig.lock);
+    if (co_prof_sig.users++ == 0) {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_sigaction = co_prof_handler;
+        sa.sa_flags = SA_SIGINFO | SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGPROF, &sa, &co_prof_sig.old);
+    }
+    pthread_mutex_unlock(&co_prof_sig.lock);
+}
+
+static void co_prof_handler_put() {
+    pthread_mutex_lock(&co_prof_sig.lock);
+    if (--co_prof_sig.users == 0) {
+        sigaction(SIGPROF, &co_prof_sig.old, NULL);
+    }
+    pthread_mutex_unlock(&co_prof_sig.lock);
+}
+
+static void co_prof_free(struct co_runtime *r);
+
+int co_prof_start(int hz) {
+    co_runtime_self();
+    if (rt->prof || hz <= 0) {
+        return -1;
+    }
+    struct co_prof *prof = (struct co_prof *)malloc(sizeof(struct co_prof));
+    if (prof == NULL) {
+        return -1;
+    }
+    prof->num = 0;
+    prof->dropped = 0;
+
+    pthread_attr_t attr;
+    void *addr;
+    size_t size;
+    prof->main_lo = prof->main_hi = 0;
+    if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+        if (pthread_attr_getstack(&attr, &addr, &size) == 0) {
+            prof->main_lo = (uintptr_t)addr;
+            prof->main_hi = (uintptr_t)addr + size;
+        }
+        pthread_attr_destroy(&attr);
+    }
+
+    // 按本线程消耗的 CPU 时间计时, 信号只发给本线程
+    struct sigevent sev;
+    memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify = SIGEV_THREAD_ID;
+    sev.sigev_signo = SIGPROF;
+    sev._sigev_un._tid = gettid();
+    if (timer_create(CLOCK_THREAD_CPUTIME_ID, &sev, &prof->timer) != 0) {
+        free(prof);
+        return -1;
+    }
+    co_prof_handler_get();
+    rt->prof = prof;
+
+    struct itimerspec its;
+    long period = 1000000000L / hz;
+    its.it_interval.tv_sec = period / 1000000000L;
+    its.it_interval.tv_nsec = period % 1000000000L;
+    its.it_value = its.it_interval;
+    if (timer_settime(prof->timer, 0, &its, NULL) != 0) {
+        co_prof_free(rt);
+        return -1;
+    }
+    return 0;
+}
+
+static void co_prof_free(struct co_runtime *r) {
+    if (r->prof == NULL) {
         return ;
     }
+    timer_delete(r->prof->timer);
+    free(r->prof);
+    r->prof = NULL;
+    co_prof_handler_put();
+}
+
+void co_prof_stop() {
+    co_runtime_self();
+    co_prof_free(rt);
+}
+
+static void co_prof_append_frame(char *buf, size_t size, size_t *len, uintptr_t pc) {
+    Dl_info info;
+    int found = dladdr((void *)pc, &info);
+    int n;
+    if (found && info.dli_sname) {
+        n = snprintf(buf + *len, size - *len, ";%s", info.dli_sname);
+    } else if (found && info.dli_fname) {
+        const char *base = strrchr(info.dli_fname, '/');
+        n = snprintf(buf + *len, size - *len, ";[%s+0x%lx]", base ? base + 1 : info.dli_fname,
+                     (unsigned long)(pc - (uintptr_t)info.dli_fbase));
+    } else {
+        n = snprintf(buf + *len, size - *len, ";0x%lx", (unsigned long)pc);
+    }
+    if (n > 0) {
+        *len = (*len + n < size) ? *len + n : size - 1;
+    }
+}
+
+static int co_prof_line_cmp(const void *a, const void *b) {
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+// 输出 flamegraph.pl 可以直接使用的 folded 格式, 然后清空样本
+int co_prof_dump(const char *path) {
+    co_runtime_self();
+    struct co_prof *prof = rt->prof;
+    if (prof == NULL) {
+        return -1;
+    }
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) {
+        return -1;
+    }
+
+    sigset_t set, old;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPROF);
+    pthread_sigmask(SIG_BLOCK, &set, &old);
+
+    // 先把每个样本符号化成一行, 再按行排序合并相同的调用栈
+    int num = prof->num;
+    char **lines = (char **)calloc(num + 1, sizeof(char *));
+    char buf[CO_PROF_NAME + CO_PROF_DEPTH * 128];
+    for (int i = 0; lines && i < num; i++) {
+        struct co_prof_sample *sample = &prof->samples[i];
+        size_t len = snprintf(buf, sizeof(buf), "%s", sample->name);
+        for (int k = sample->depth - 1; k >= 0; k--) {
+            // 返回地址指向 call 的下一条指令, 减一才落在调用者内部
+            co_prof_append_frame(buf, sizeof(buf), &len, k == 0 ? sample->pc[k] : sample->pc[k] - 1);
+        }
+        lines[i] = strdup(buf);
+    }
+    if (lines) {
+        qsort(lines, num, sizeof(char *), co_prof_line_cmp);
+        for (int i = 0, j; i < num; i = j) {
+            for (j = i + 1; j < num && strcmp(lines[i], lines[j]) == 0; j++) ;
+            fprintf(fp, "%s %d\n", lines[i], j - i);
+        }
+        for (int i = 0; i < num; i++) {
+            free(lines[i]);
+        }
+        free(lines);
+    }
+    if (prof->dropped) {
+        fprintf(stderr, "co_prof: %lu samples dropped, dump more often\n", prof->dropped);
+    }
+    prof->num = 0;
+    prof->dropped = 0;
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    fclose(fp);
+    return lines ? 0 : -1;
+}
+
+static pthread_once_t co_tsc_once = PTHREAD_ONCE_INIT;
+static double co_ns_per_tsc;
+
+static void co_tsc_init() {
+    uint64_t t0 = co_now_ns(), c0 = co_rdtsc(), t1;
+    while ((t1 = co_now_ns()) - t0 < CO_TSC_CALIBRATE_NS) ;
+    co_ns_per_tsc = (double)(t1 - t0) / (double)(co_rdtsc() - c0);
+}
+
+int co_watchdog_start(unsigned long long slice_ns, unsigned long long wait_ns, co_wd_func fn, void *arg) {
+    co_runtime_self();
+    if (rt->wd) {
+        return -1;
+    }
+    struct co_watchdog *wd = (struct co_watchdog *)calloc(1, sizeof(struct co_watchdog));
+    uint64_t *stamp = (uint64_t *)malloc(rt->run_table.cap * sizeof(uint64_t));
+    if (wd == NULL || stamp == NULL) {
+        free(wd);
+        free(stamp);
+        return -1;
+    }
+    pthread_once(&co_tsc_once, co_tsc_init);
+    wd->ns_per_tsc = co_ns_per_tsc;
+    wd->slice_tsc = (uint64_t)(slice_ns / co_ns_per_tsc);
+    wd->wait_tsc = (uint64_t)(wait_ns / co_ns_per_tsc);
+    wd->fn = fn;
+    wd->arg = arg;
+    // 已经在运行表里的协程从现在开始计时
+    uint64_t now = co_rdtsc();
+    for (int i = 0; i < rt->run_table.num; i++) {
+        stamp[i] = now;
+    }
+    wd->in = now;
+    rt->run_table.stamp = stamp;
+    rt->wd = wd;
+    return 0;
+}
+
+static void co_watchdog_free(struct co_runtime *r) {
+    free(r->wd);
+    r->wd = NULL;
+    free(r->run_table.stamp);
+    r->run_table.stamp = NULL;
+}
+
+void co_watchdog_stop() {
+    co_runtime_self();
+    co_watchdog_free(rt);
+}
+
+int co_watchdog_hist(int kind, unsigned long hist[CO_WD_BUCKETS]) {
+    co_runtime_self();
+    if (rt->wd == NULL || (kind != CO_WD_SLICE && kind != CO_WD_WAIT)) {
+        return -1;
+    }
+    memcpy(hist, rt->wd->hist[kind], sizeof(rt->wd->hist[kind]));
+    return 0;
+}
+
+// 每行: 类型 区间下限(ns) 次数, 只输出非空的区间
+int co_watchdog_dump(const char *path) {
+    co_runtime_self();
+    struct co_watchdog *wd = rt->wd;
+    if (wd == NULL) {
+        return -1;
+    }
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) {
+        return -1;
+    }
+    for (int kind = CO_WD_SLICE; kind <= CO_WD_WAIT; kind++) {
+        for (int i = 0; i < CO_WD_BUCKETS; i++) {
+            if (wd->hist[kind][i]) {
+                fprintf(fp, "%s %llu %lu\n", kind == CO_WD_SLICE ? "slice" : "wait",
+                        1ull << i, wd->hist[kind][i]);
+            }
+        }
+    }
+    fclose(fp);
+    return 0;
 }
 
 void co_free(struct co *co) {
-    if (!co || co == &main_co) return;
+    if (!co || co == &rt->main_co) return;
+    if (co->stackless) {
+        free(co);
+        return ;
+    }
+    if (co->batch) {
+        struct co_batch *batch = co->batch;
+        co_stack_release(co);
+        co_region_release(co);
+        while (co->cleanup) {
+            struct co_cleanup *c = co->cleanup;
+            co->cleanup = c->next;
+            free(c);
+        }
+        free(co->specific_ext);
+        // 映射里可能有 current 的栈, co_runtime_destroy 在协程中退出时不会走到这里
+        if (--batch->refs == 0) {
+            munmap(batch, batch->ctrl_size + batch->stack_size);
+        }
+        return ;
+    }
     if (co->name) {
         free(co->name);
         co->name = NULL;
     }
-    if (co->stack) {
-        free(co->stack);
-        co->stack = NULL;
+    co_stack_release(co);
+    co_region_release(co);
+    while (co->cleanup) {
+        struct co_cleanup *c = co->cleanup;
+        co->cleanup = c->next;
+        free(c);
     }
+    free(co->specific_ext);
     free(co);
 }
 
+static void co_runtime_destroy(struct co_runtime *r) {
+    debug("co runtime destroy\n");
+    struct co_post_node *node, *next;
+    co_rt = r; // co_free 需要知道 main_co
+    // 协程中调用了 exit()/pthread_exit(): 可能还运行在它的栈上 (无栈协程是 runtime 栈),
+    //   这个协程和它的栈 (连同所在的 arena 区域或整批映射) 不释放, 其余照常回收;
+    //   进程退出时无所谓, pthread_exit 时这部分就永久泄漏了
+    struct co *running = current != &r->main_co ? current : NULL;
+    for (int i = 0; i < r->run_table.num; i++) {
+        if (r->run_table.tab[i] != running) { // 正在运行的只会在 run_table 中
+            co_free(r->run_table.tab[i]);
+        }
+    }
+    for (int i = 0; i < r->wait_table.num; i++) {
+        co_free(r->wait_table.tab[i]);
+    }
+    for (int i = 0; i < r->dead_table.num; i++) {
+        co_free(r->dead_table.tab[i]);
+    }
+    for (node = r->post_head; node != NULL; node = next) {
+        next = node->next;
+        free(node);
+    }
+    for (node = r->post_defer; node != NULL; node = next) {
+        next = node->next;
+        free(node);
+    }
+    co_table_free(&r->run_table);
+    co_table_free(&r->wait_table);
+    co_table_free(&r->dead_table);
+    co_stack_arena_free(&r->arena, running && running->stack_arena ? running->stack : NULL);
+    co_region_release(&r->main_co);
+    co_chunk_flush(r, 0);
+    free(r->main_co.specific_ext);
+    co_prof_free(r);
+    co_watchdog_free(r);
+    close(r->efd);
+    co_rt = NULL;
+    if (running == NULL || !running->stackless) {
+        free(r);
+    }
+}
+
+// 主线程不会触发 pthread key 的析构, 在进程退出时回收
 __attribute__((destructor))
 static void co_main_exit() {
     debug("co main exit\n");
-    for (int i = 0; i < co_run_table.num; i++) {
-        co_free(co_run_table.tab[i]);
-    }
-    for (int i = 0; i < co_wait_table.num; i++) {
-        co_free(co_wait_table.tab[i]);
-    }
-    for (int i = 0; i < co_dead_table.num; i++) {
-        co_free(co_dead_table.tab[i]);
+    if (co_rt) {
+        pthread_setspecific(co_rt_key, NULL);
+        co_runtime_destroy(co_rt);
     }
 }
 
 
-#undef current
\ No newline at end of file
+#undef current
+#undef rt
@@ -1,8 +1,103 @@
 #ifndef CO_H
 #define CO_H
 
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CO_CANCELED (-1)
+#define CO_KEY_MAX  64
+#define CO_INLINE_MAX 256 // co_start_inline 的参数上限
+
+enum co_arena_backing {
+    CO_ARENA_NORMAL = 0,  // 普通页
+    CO_ARENA_THP,         // madvise(MADV_HUGEPAGE)
+    CO_ARENA_HUGETLB,     // MAP_HUGETLB
+};
+
 struct co* co_start(const char *name, void (*func)(void *), void *arg);
-void co_yield();
-void co_wait(struct co *co);
+#if defined(__cplusplus) && __cplusplus >= 202002L
+int  co_yield_() __asm__("co_yield"); // C++20 中 co_yield 是关键字
+#else
+int  co_yield();
+#endif
+int  co_yield_to(struct co *co);
+int  co_wait(struct co *co);
+void co_detach(struct co *co); // 已结束的立即释放, 否则结束时释放; 之后不能再使用 co
+
+// 在新协程的栈顶保留 arg_size 字节, *arg 指向它, 在下一次让出前由调用者填好
+//   即使协程还没运行就被取消, func 也会被调用, 以便释放 arg
+struct co* co_start_inline(const char *name, void (*func)(void *), size_t arg_size, void **arg);
+
+int  co_start_batch(const char *name, void (*func)(void *), void *args[], int n, struct co *out_cos[]);
+int  co_wait_batch(struct co *cos[], int n);
+
+struct co_runtime;
+struct co_runtime* co_runtime_current();
+struct co* co_self();
+int  co_park();
+// 可以在任意线程调用, 但没有引用计数, 由调用者保证目标还活着:
+//   runtime 在所属线程退出时释放, 之后不能再向它 co_post
+//   co 结束后仍留在 dead_table 中, 唤醒已结束的会被忽略; 但 detach 的 (包括 co_post 创建的)
+//   结束时立即释放, 只能在确定它还没结束时唤醒
+void co_post(struct co_runtime *runtime, void (*fn)(void *), void *arg);
+void co_wake_external(struct co *co);
+
+void co_cancel(struct co *co);
+void co_cancel_tree(struct co *co);
+int  co_canceled();
+void co_cleanup_push(void (*fn)(void *), void *arg);
+void co_cleanup_pop(int execute);
+
+int   co_key_create(void (*dtor)(void *));
+void* co_getspecific(int key);
+void  co_setspecific(int key, const void *value);
+
+int  co_prof_start(int hz);
+void co_prof_stop();
+int  co_prof_dump(const char *path);
+
+int  co_stack_arena(size_t region_size, int numa_node);
+
+void* co_alloc(size_t size);
+
+// 调度 watchdog: 两次让出之间运行过久, 或可运行但很久没有被选中的协程
+enum co_wd_kind {
+    CO_WD_SLICE = 0, // 一次连续运行的时长
+    CO_WD_WAIT,      // 从可运行到被选中的时长
+};
+#define CO_WD_BUCKETS 40 // hist[i] 统计 [2^i, 2^(i+1)) ns
+typedef void (*co_wd_func)(const char *name, int kind, unsigned long long ns, void *arg);
+
+int  co_watchdog_start(unsigned long long slice_ns, unsigned long long wait_ns, co_wd_func fn, void *arg);
+void co_watchdog_stop();
+int  co_watchdog_hist(int kind, unsigned long hist[CO_WD_BUCKETS]);
+int  co_watchdog_dump(const char *path);
+
+// 无栈协程: 每次调度都从头调用 func, 由下面的宏跳回上次让出的位置
+//   跨越让出点的状态必须放在 frame 中, 局部变量不会保留
+enum co_sl_state {
+    CO_SL_READY = 0, // 让出, 保持可运行
+    CO_SL_BLOCKED,   // 在 co_sl_wait 中等待
+    CO_SL_DONE,      // 结束
+};
+typedef int (*co_sl_func)(int *pc, void *frame);
+
+struct co* co_start_sl(const char *name, co_sl_func func, const void *frame, size_t frame_size);
+int  co_sl_wait(struct co *co);
+
+#define CO_SL_BEGIN(pc)     switch (*(pc)) { case 0:
+#define CO_SL_YIELD(pc)     do { *(pc) = __LINE__; return CO_SL_READY; case __LINE__:; } while (0)
+// 只有 co 结束时才会被唤醒, 恢复点放在判断之后, 唤醒后不再访问 co (detach 的已经释放了)
+#define CO_SL_AWAIT(pc, co) do { if (co_sl_wait(co)) { *(pc) = __LINE__; return CO_SL_BLOCKED; \
+                                 case __LINE__:; } } while (0)
+#define CO_SL_EXIT(pc)      do { *(pc) = -1; return CO_SL_DONE; } while (0)
+#define CO_SL_END(pc)       } *(pc) = -1; return CO_SL_DONE
+
+#ifdef __cplusplus
+}
+#endif
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,299 @@
+#ifndef CO_HPP
+#define CO_HPP
+
+// co.h 的 C++17/20 封装, 只有头文件
+//   struct co 占用了全局的 co 这个名字, 命名空间用 toyco
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "co.h"
+
+namespace toyco {
+
+namespace detail {
+
+// 捕获放在新协程的栈顶, 协程结束时在自己的栈上析构
+template <typename F>
+void run_inline(void *arg) noexcept {
+    F *f = static_cast<F *>(arg);
+    if (!co_canceled()) { // 还没运行就被取消时只析构
+        (*f)();
+    }
+    f->~F();
+}
+
+// 放不下的捕获 new 一份, 栈顶只放指针
+template <typename F>
+void run_heap(void *arg) noexcept {
+    std::unique_ptr<F> f(*static_cast<F **>(arg));
+    if (!co_canceled()) {
+        (*f)();
+    }
+}
+
+// 挂在等待者自己栈上的节点, 不需要分配
+struct waiter {
+    struct co *co;
+    waiter *next;
+    bool queued;
+};
+
+class wait_queue {
+public:
+    bool empty() const noexcept { return head_ == nullptr; }
+
+    // 挂起当前协程直到被 wake_one/wake_all 取出, 没被取出之前被取消时返回 CO_CANCELED
+    int wait() noexcept {
+        waiter w{co_self(), nullptr, true};
+        if (tail_) {
+            tail_->next = &w;
+        } else {
+            head_ = &w;
+        }
+        tail_ = &w;
+        int ret;
+        do {
+            ret = co_park();
+        } while (ret == 0 && w.queued); // 之前遗留的唤醒
+        if (!w.queued) { // 已经被选中, 例如锁已经交给了自己
+            return 0;
+        }
+        remove(&w);
+        return ret;
+    }
+
+    // 取出最早的等待者并唤醒, 返回它, 没有时返回 nullptr
+    struct co *wake_one() noexcept {
+        waiter *w = head_;
+        if (w == nullptr) {
+            return nullptr;
+        }
+        head_ = w->next;
+        if (head_ == nullptr) {
+            tail_ = nullptr;
+        }
+        w->queued = false;
+        struct co *co = w->co;
+        co_wake_external(co); // 同一线程直接放回运行表
+        return co;
+    }
+
+    void wake_all() noexcept {
+        while (wake_one()) {
+        }
+    }
+
+private:
+    void remove(waiter *w) noexcept {
+        waiter *prev = nullptr;
+        for (waiter *p = head_; p != nullptr; prev = p, p = p->next) {
+            if (p == w) {
+                (prev ? prev->next : head_) = p->next;
+                if (tail_ == p) {
+                    tail_ = prev;
+                }
+                w->queued = false;
+                return;
+            }
+        }
+    }
+
+    waiter *head_ = nullptr;
+    waiter *tail_ = nullptr;
+};
+
+} // namespace detail
+
+inline int yield() noexcept {
+#if __cplusplus >= 202002L
+    return co_yield_();
+#else
+    return co_yield();
+#endif
+}
+
+inline int yield_to(struct co *co) noexcept { return co_yield_to(co); }
+inline bool canceled() noexcept { return co_canceled() != 0; }
+
+// 协程句柄, 只能移动; 析构时还没 join/detach 就先等待它结束 (和 std::jthread 一样)
+class task {
+public:
+    task() noexcept = default;
+    explicit task(struct co *co) noexcept : co_(co) {}
+    task(task &&other) noexcept : co_(std::exchange(other.co_, nullptr)) {}
+    task &operator=(task &&other) noexcept {
+        if (this != &other) {
+            if (co_) {
+                join();
+            }
+            co_ = std::exchange(other.co_, nullptr);
+        }
+        return *this;
+    }
+    task(const task &) = delete;
+    task &operator=(const task &) = delete;
+    ~task() {
+        if (co_) {
+            join();
+        }
+    }
+
+    bool joinable() const noexcept { return co_ != nullptr; }
+    struct co *get() const noexcept { return co_; }
+
+    // 等待结束并释放协程; 当前协程被取消时不再等待, 返回 CO_CANCELED, 它结束后自动释放
+    int join() noexcept {
+        assert(co_ != nullptr);
+        int ret = co_wait(co_);
+        co_detach(std::exchange(co_, nullptr));
+        return ret;
+    }
+
+    void detach() noexcept {
+        assert(co_ != nullptr);
+        co_detach(std::exchange(co_, nullptr));
+    }
+
+    void cancel() noexcept { co_cancel(co_); }
+    void cancel_tree() noexcept { co_cancel_tree(co_); }
+
+private:
+    struct co *co_ = nullptr;
+};
+
+// 不超过 CO_INLINE_MAX 且构造不抛异常的可调用对象放在协程栈顶, 否则 new 一份
+//   func 不能抛出异常, 协程栈上没有可以展开到的地方
+template <typename F>
+task spawn(const char *name, F &&f) {
+    using fn = std::decay_t<F>;
+    static_assert(std::is_invocable_v<fn &>, "spawn needs a callable with no arguments");
+    if constexpr (sizeof(fn) <= CO_INLINE_MAX && alignof(fn) <= 16 &&
+                  std::is_nothrow_constructible_v<fn, F &&>) {
+        void *arg;
+        struct co *co = co_start_inline(name, &detail::run_inline<fn>, sizeof(fn), &arg);
+        ::new (arg) fn(std::forward<F>(f));
+        return task(co);
+    } else {
+        fn *p = new fn(std::forward<F>(f));
+        void *arg;
+        struct co *co = co_start_inline(name, &detail::run_heap<fn>, sizeof(p), &arg);
+        *static_cast<fn **>(arg) = p;
+        return task(co);
+    }
+}
+
+template <typename F>
+task spawn(F &&f) {
+    return spawn("toyco", std::forward<F>(f));
+}
+
+// 协程互斥锁, 只在同一线程的协程之间使用; 解锁时直接交给最早的等待者
+class mutex {
+public:
+    mutex() = default;
+    mutex(const mutex &) = delete;
+    mutex &operator=(const mutex &) = delete;
+
+    // 成功返回 0, 等待中被取消返回 CO_CANCELED 且没有拿到锁
+    [[nodiscard]] int lock() noexcept {
+        if (!locked_) {
+            locked_ = true;
+            return 0;
+        }
+        return waiters_.wait(); // 被唤醒时锁已经交给了自己
+    }
+
+    bool try_lock() noexcept {
+        if (locked_) {
+            return false;
+        }
+        locked_ = true;
+        return true;
+    }
+
+    void unlock() noexcept {
+        assert(locked_);
+        if (waiters_.wake_one() == nullptr) {
+            locked_ = false;
+        }
+    }
+
+private:
+    bool locked_ = false;
+    detail::wait_queue waiters_;
+};
+
+// 有界 channel, 只在同一线程的协程之间使用; 缓冲区在构造时一次分配
+template <typename T>
+class channel {
+public:
+    explicit channel(size_t capacity = 1)
+        : buf_(new std::optional<T>[capacity]), cap_(capacity) {
+        assert(capacity > 0);
+    }
+    channel(const channel &) = delete;
+    channel &operator=(const channel &) = delete;
+
+    // 缓冲区满时等待; 已关闭或被取消时返回 false
+    bool send(T value) {
+        while (num_ == cap_ && !closed_) {
+            if (senders_.wait() == CO_CANCELED) {
+                return false;
+            }
+        }
+        if (closed_) {
+            return false;
+        }
+        buf_[(head_ + num_) % cap_].emplace(std::move(value));
+        num_++;
+        receivers_.wake_one();
+        return true;
+    }
+
+    // 缓冲区空时等待; 已关闭且取完或被取消时返回 std::nullopt
+    std::optional<T> recv() {
+        while (num_ == 0 && !closed_) {
+            if (receivers_.wait() == CO_CANCELED) {
+                return std::nullopt;
+            }
+        }
+        if (num_ == 0) {
+            return std::nullopt;
+        }
+        std::optional<T> value = std::move(buf_[head_]);
+        buf_[head_].reset();
+        head_ = (head_ + 1) % cap_;
+        num_--;
+        senders_.wake_one();
+        return value;
+    }
+
+    // 之后的 send 失败, recv 取完剩下的数据后返回 std::nullopt
+    void close() noexcept {
+        closed_ = true;
+        senders_.wake_all();
+        receivers_.wake_all();
+    }
+
+    size_t size() const noexcept { return num_; }
+    bool closed() const noexcept { return closed_; }
+
+private:
+    std::unique_ptr<std::optional<T>[]> buf_;
+    size_t cap_;
+    size_t head_ = 0;
+    size_t num_ = 0;
+    bool closed_ = false;
+    detail::wait_queue senders_;
+    detail::wait_queue receivers_;
+};
+
+} // namespace toyco
+
+#endif
@@ -2,6 +2,13 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
 #include "co-test.h"
 
 int g_count = 0;
@@ -118,6 +125,679 @@ static void test_2() {
     q_free(queue);
 }
 
+// -----------------------------------------------
+
+static __thread int t_count = 0;
+
+static void thread_work(void *arg) {
+    for (int i = 0; i < 1000; ++i) {
+        t_count++;
+        co_yield();
+    }
+}
+
+static void *thread_main(void *arg) {
+    struct co *thd1 = co_start("thread-work-1", thread_work, NULL);
+    struct co *thd2 = co_start("thread-work-2", thread_work, NULL);
+    co_wait(thd1);
+    co_wait(thd2);
+    *(int *)arg = t_count;
+    return NULL;
+}
+
+static void test_3() {
+    pthread_t tids[4];
+    int counts[4];
+    for (int i = 0; i < 4; i++) {
+        pthread_create(&tids[i], NULL, thread_main, &counts[i]);
+    }
+    for (int i = 0; i < 4; i++) {
+        pthread_join(tids[i], NULL);
+        printf("thread-%d: %d  ", i, counts[i]);
+        assert(counts[i] == 2000);
+    }
+}
+
+// -----------------------------------------------
+
+#define POST_NUM 100
+
+struct post_ctx {
+    struct co_runtime *runtime;
+    struct co *waiter;
+    int done;
+};
+
+static void post_job(void *arg) {
+    struct post_ctx *ctx = (struct post_ctx *)arg;
+    co_yield();
+    if (++ctx->done == POST_NUM) {
+        co_wake_external(ctx->waiter);
+    }
+}
+
+static void *post_thread(void *arg) {
+    struct post_ctx *ctx = (struct post_ctx *)arg;
+    for (int i = 0; i < POST_NUM; i++) {
+        co_post(ctx->runtime, post_job, ctx);
+    }
+    return NULL;
+}
+
+#define PARK_NUM 1100 // 超过同时存活的 co_post 协程上限 (1024)
+
+struct park_ctx {
+    struct co_runtime *runtime;
+    struct co *waiter;
+    struct co *cos[PARK_NUM]; // 按启动顺序
+    int started;
+    int done;
+};
+
+static void park_job(void *arg) {
+    struct park_ctx *ctx = (struct park_ctx *)arg;
+    __atomic_store_n(&ctx->cos[ctx->started++], co_self(), __ATOMIC_RELEASE);
+    co_park(); // 等生产者线程唤醒
+    if (++ctx->done == PARK_NUM) {
+        co_wake_external(ctx->waiter);
+    }
+}
+
+// 上限内的都在 co_park 时, 后面的要等前面的被唤醒并结束才能启动
+static void *park_thread(void *arg) {
+    struct park_ctx *ctx = (struct park_ctx *)arg;
+    for (int i = 0; i < PARK_NUM; i++) {
+        co_post(ctx->runtime, park_job, ctx);
+    }
+    for (int i = 0; i < PARK_NUM; i++) {
+        struct co *co;
+        while ((co = __atomic_load_n(&ctx->cos[i], __ATOMIC_ACQUIRE)) == NULL) {
+            sched_yield();
+        }
+        co_wake_external(co);
+    }
+    return NULL;
+}
+
+static void test_4() {
+    struct post_ctx ctx = { co_runtime_current(), co_self(), 0 };
+    pthread_t tid;
+    pthread_create(&tid, NULL, post_thread, &ctx);
+    while (ctx.done < POST_NUM) {
+        co_park();
+    }
+    pthread_join(tid, NULL);
+
+    static struct park_ctx park;
+    park.runtime = co_runtime_current();
+    park.waiter = co_self();
+    pthread_create(&tid, NULL, park_thread, &park);
+    while (park.done < PARK_NUM) {
+        co_park();
+    }
+    pthread_join(tid, NULL);
+    printf("posted: %d, parked %d", ctx.done, park.done);
+    assert(ctx.done == POST_NUM && park.done == PARK_NUM);
+}
+
+// -----------------------------------------------
+
+static int g_cleaned = 0;
+
+static void on_cleanup(void *arg) {
+    g_cleaned++;
+}
+
+static void cancel_leaf(void *arg) {
+    co_cleanup_push(on_cleanup, NULL);
+    while (co_yield() != CO_CANCELED) ;
+}
+
+static void cancel_parked(void *arg) {
+    co_cleanup_push(on_cleanup, NULL);
+    int ret = co_park();
+    assert(ret == CO_CANCELED);
+}
+
+static struct co *g_children[3];
+
+static void cancel_root(void *arg) {
+    g_children[0] = co_start("cancel-leaf", cancel_leaf, NULL);
+    g_children[1] = co_start("cancel-parked", cancel_parked, NULL);
+    g_children[2] = co_start("cancel-new", cancel_leaf, NULL);
+    co_cleanup_push(on_cleanup, NULL);
+    int ret = co_wait(g_children[0]);
+    assert(ret == CO_CANCELED);
+}
+
+static void test_5() {
+    struct co *root = co_start("cancel-root", cancel_root, NULL);
+    for (int i = 0; i < 100; i++) {
+        co_yield();
+    }
+    co_cancel_tree(root);
+    co_wait(root);
+    for (int i = 0; i < 3; i++) {
+        co_wait(g_children[i]);
+    }
+    printf("cleaned: %d", g_cleaned);
+    assert(g_cleaned == 4 || g_cleaned == 3); // cancel-new 可能从未运行
+}
+
+// -----------------------------------------------
+
+static int g_keys[10];
+static int g_dtors = 0;
+
+static void key_dtor(void *value) {
+    g_dtors++;
+}
+
+static void key_work(void *arg) {
+    intptr_t id = (intptr_t)arg;
+    co_setspecific(g_keys[0], (void *)id);
+    co_setspecific(g_keys[9], (void *)(id * 10));
+    for (int i = 0; i < 100; i++) {
+        co_yield();
+        assert(co_getspecific(g_keys[0]) == (void *)id);
+        assert(co_getspecific(g_keys[9]) == (void *)(id * 10));
+        assert(co_getspecific(g_keys[5]) == NULL);
+    }
+}
+
+static void test_6() {
+    for (int i = 0; i < 10; i++) {
+        g_keys[i] = co_key_create(key_dtor);
+        assert(g_keys[i] >= 0);
+    }
+    struct co *thd1 = co_start("key-1", key_work, (void *)1);
+    struct co *thd2 = co_start("key-2", key_work, (void *)2);
+    co_wait(thd1);
+    co_wait(thd2);
+    printf("dtors: %d", g_dtors);
+    assert(g_dtors == 4);
+}
+
+// -----------------------------------------------
+
+static volatile unsigned long g_spin;
+
+static void prof_work(void *arg) {
+    for (int i = 0; i < 100; i++) {
+        for (int j = 0; j < 200000; j++) {
+            g_spin++;
+        }
+        co_yield();
+    }
+}
+
+static void test_7() {
+    const char *path = "libco-test-prof.folded";
+    assert(co_prof_start(1000) == 0);
+    struct co *thd1 = co_start("prof-1", prof_work, NULL);
+    struct co *thd2 = co_start("prof-2", prof_work, NULL);
+    co_wait(thd1);
+    co_wait(thd2);
+    assert(co_prof_dump(path) == 0);
+    co_prof_stop();
+
+    FILE *fp = fopen(path, "r");
+    assert(fp != NULL);
+    char line[4096];
+    int found = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, "prof-", 5) == 0) {
+            found = 1;
+        }
+    }
+    fclose(fp);
+    remove(path);
+    // 1 Hz 的周期正好是 1 秒; 停止后恢复原来的 SIGPROF 处理函数
+    assert(co_prof_start(1) == 0);
+    co_prof_stop();
+    struct sigaction old;
+    sigaction(SIGPROF, NULL, &old);
+    printf("prof samples: %s, handler %s", found ? "found" : "missing",
+           old.sa_handler == SIG_DFL ? "restored" : "leaked");
+    assert(found && old.sa_handler == SIG_DFL);
+}
+
+// -----------------------------------------------
+
+#define ARENA_CO_NUM 2000
+
+static int g_arena_done = 0;
+
+static void arena_work(void *arg) {
+    volatile char buf[1024]; // 用到一些栈空间
+    buf[0] = 1;
+    for (int i = 0; i < 3; i++) {
+        co_yield();
+    }
+    g_arena_done += buf[0];
+}
+
+static void *arena_thread(void *arg) {
+    static struct co *cos[ARENA_CO_NUM];
+    int backing = co_stack_arena(0, -1);
+    assert(backing >= 0);
+    for (int round = 0; round < 2; round++) { // 第二轮复用回收的栈
+        for (int i = 0; i < ARENA_CO_NUM; i++) {
+            cos[i] = co_start("arena", arena_work, NULL);
+        }
+        for (int i = 0; i < ARENA_CO_NUM; i++) {
+            co_wait(cos[i]);
+        }
+    }
+    return NULL;
+}
+
+static void test_8() {
+    pthread_t tid;
+    pthread_create(&tid, NULL, arena_thread, NULL);
+    pthread_join(tid, NULL);
+    printf("arena: %d", g_arena_done);
+    assert(g_arena_done == 2 * ARENA_CO_NUM);
+}
+
+// -----------------------------------------------
+
+#define BATCH_CO_NUM 3000
+
+static int g_batch_sum = 0;
+
+static void batch_work(void *arg) {
+    co_yield();
+    g_batch_sum += (int)(intptr_t)arg;
+}
+
+static void test_9() {
+    static void *args[BATCH_CO_NUM];
+    static struct co *cos[BATCH_CO_NUM];
+    int expect = 0;
+    for (int i = 0; i < BATCH_CO_NUM; i++) {
+        args[i] = (void *)(intptr_t)i;
+        expect += i;
+    }
+    assert(co_start_batch("batch", batch_work, args, BATCH_CO_NUM, cos) == 0);
+    assert(co_wait_batch(cos, BATCH_CO_NUM) == 0);
+    assert(g_batch_sum == expect);
+
+    // 不是完整的一批时逐个等待
+    g_batch_sum = 0;
+    assert(co_start_batch("batch-part", batch_work, args, 10, cos) == 0);
+    assert(co_wait_batch(cos, 5) == 0);
+    assert(co_wait_batch(cos + 5, 5) == 0);
+    printf("batch: %d", g_batch_sum);
+    assert(g_batch_sum == 45);
+}
+
+#define SL_CO_NUM 1000
+
+static int g_sl_sum = 0;
+static int g_sl_ready = 0;
+static int g_sl_joined = 0;
+
+struct sl_count {
+    int i;
+};
+
+static int sl_count(int *pc, void *frame) {
+    struct sl_count *f = (struct sl_count *)frame;
+    CO_SL_BEGIN(pc);
+    for (f->i = 0; f->i < 3; f->i++) {
+        g_sl_sum++;
+        CO_SL_YIELD(pc);
+    }
+    CO_SL_END(pc);
+}
+
+static void sl_producer(void *arg) {
+    for (int i = 0; i < 5; i++) {
+        co_yield();
+    }
+    g_sl_ready = 1;
+}
+
+struct sl_join {
+    struct co *target;
+};
+
+static int sl_join(int *pc, void *frame) {
+    struct sl_join *f = (struct sl_join *)frame;
+    CO_SL_BEGIN(pc);
+    CO_SL_AWAIT(pc, f->target);
+    g_sl_joined = g_sl_ready; // 必须在 producer 结束之后
+    CO_SL_END(pc);
+}
+
+static void test_10() {
+    static struct co *cos[SL_CO_NUM];
+    for (int i = 0; i < SL_CO_NUM; i++) {
+        cos[i] = co_start_sl("sl-count", sl_count, NULL, sizeof(struct sl_count));
+    }
+    // 无栈协程等待有栈协程, 再被 main 等待
+    struct sl_join join = { co_start("sl-producer", sl_producer, NULL) };
+    struct co *j = co_start_sl("sl-join", sl_join, &join, sizeof(join));
+    co_cancel_tree(cos[0]); // 无栈协程不支持取消, 什么都不做
+    for (int i = 0; i < SL_CO_NUM; i++) {
+        assert(co_wait(cos[i]) == 0);
+    }
+    assert(co_wait(j) == 0);
+    assert(g_sl_joined == 1);
+    printf("stackless: %d", g_sl_sum);
+    assert(g_sl_sum == SL_CO_NUM * 3);
+}
+
+static int g_wd_slice = 0;
+static int g_wd_wait = 0;
+static int g_wd_hog_done = 0;
+
+static void wd_report(const char *name, int kind, unsigned long long ns, void *arg) {
+    if (kind == CO_WD_SLICE && strcmp(name, "wd-hog") == 0) {
+        g_wd_slice++;
+    }
+    if (kind == CO_WD_WAIT && strcmp(name, "wd-light") == 0) {
+        g_wd_wait++;
+    }
+}
+
+static void wd_hog(void *arg) {
+    for (int i = 0; i < 3; i++) {
+        struct timespec t0, t1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        do { // 不让出, 连续运行 3ms
+            clock_gettime(CLOCK_MONOTONIC, &t1);
+        } while ((t1.tv_sec - t0.tv_sec) * 1000000000L + (t1.tv_nsec - t0.tv_nsec) < 3000000L);
+        co_yield();
+    }
+    g_wd_hog_done = 1;
+}
+
+static void wd_light(void *arg) {
+    while (!g_wd_hog_done) {
+        co_yield();
+    }
+}
+
+static void test_11() {
+    assert(co_watchdog_start(1000000, 1000000, wd_report, NULL) == 0);
+    struct co *hog = co_start("wd-hog", wd_hog, NULL);
+    struct co *light = co_start("wd-light", wd_light, NULL);
+    co_wait(hog);
+    co_wait(light);
+    unsigned long slice[CO_WD_BUCKETS], wait[CO_WD_BUCKETS];
+    assert(co_watchdog_hist(CO_WD_SLICE, slice) == 0);
+    assert(co_watchdog_hist(CO_WD_WAIT, wait) == 0);
+    unsigned long long slow = 0;
+    for (int i = 20; i < CO_WD_BUCKETS; i++) { // >= 1ms
+        slow += slice[i];
+    }
+    co_watchdog_stop();
+    printf("watchdog: slice %s, wait %s", g_wd_slice == 3 ? "found" : "missing",
+           g_wd_wait > 0 ? "found" : "missing");
+    assert(g_wd_slice == 3 && g_wd_wait > 0 && slow >= 3);
+}
+
+#define REGION_ALLOCS 2000
+
+static int g_region_ok = 0;
+
+static void region_work(void *arg) {
+    intptr_t seed = (intptr_t)arg;
+    // 协程栈只有 32KB, 数组本身也用 co_alloc
+    unsigned char **ptrs = (unsigned char **)co_alloc(sizeof(unsigned char *) * REGION_ALLOCS);
+    size_t *sizes = (size_t *)co_alloc(sizeof(size_t) * REGION_ALLOCS);
+    for (int i = 0; i < REGION_ALLOCS; i++) {
+        // 偶尔有一个比块还大的分配
+        sizes[i] = i % 500 == 499 ? 40000 : (size_t)(i * 7 + seed) % 300 + 1;
+        ptrs[i] = (unsigned char *)co_alloc(sizes[i]);
+        assert(ptrs[i] != NULL && ((uintptr_t)ptrs[i] & 15) == 0);
+        memset(ptrs[i], (int)(i + seed) & 0xff, sizes[i]);
+        if (i % 100 == 0) {
+            co_yield();
+        }
+    }
+    for (int i = 0; i < REGION_ALLOCS; i++) {
+        for (size_t k = 0; k < sizes[i]; k++) {
+            assert(ptrs[i][k] == ((i + seed) & 0xff));
+        }
+    }
+    g_region_ok++;
+}
+
+static void test_12() {
+    // 第二轮复用第一轮结束时归还的块
+    for (int round = 0; round < 2; round++) {
+        struct co *cos[4];
+        for (int i = 0; i < 4; i++) {
+            cos[i] = co_start("region", region_work, (void *)(intptr_t)(round * 4 + i));
+        }
+        for (int i = 0; i < 4; i++) {
+            co_wait(cos[i]);
+        }
+    }
+    printf("region: %d", g_region_ok);
+    assert(g_region_ok == 8);
+}
+
+#define HANDOFF_ROUNDS 1000
+
+static struct co *g_ping, *g_pong;
+static struct co *g_last;
+static int g_handoff_hits = 0, g_handoff_done = 0;
+
+static void handoff_pong(void *arg) {
+    for (int i = 0; i < HANDOFF_ROUNDS; i++) {
+        g_handoff_hits += g_last == g_ping;
+        g_last = g_pong;
+        co_yield_to(g_ping);
+    }
+}
+
+static void handoff_bg(void *arg) {
+    while (!g_handoff_done) {
+        g_last = NULL;
+        co_yield();
+    }
+}
+
+static void test_13() {
+    struct co *bg[100];
+    for (int i = 0; i < 100; i++) {
+        bg[i] = co_start("bg", handoff_bg, NULL);
+    }
+    // main 自己做 ping, 这样第一个球一定是 ping 发出的
+    g_ping = co_self();
+    g_pong = co_start("pong", handoff_pong, NULL);
+    for (int i = 0; i < HANDOFF_ROUNDS; i++) {
+        g_last = g_ping;
+        co_yield_to(g_pong);
+        g_handoff_hits += g_last == g_pong;
+    }
+    g_handoff_done = 1;
+    co_wait(g_pong);
+    for (int i = 0; i < 100; i++) {
+        co_wait(bg[i]);
+    }
+    // 目标已经结束时退化为 co_yield
+    assert(co_yield_to(g_pong) == 0);
+    printf("handoff: %d/%d", g_handoff_hits, 2 * HANDOFF_ROUNDS);
+    assert(g_handoff_hits == 2 * HANDOFF_ROUNDS);
+}
+
+struct inline_arg {
+    int id;
+    char tag[100];
+};
+
+static int g_inline_sum = 0, g_inline_released = 0;
+
+static void inline_work(void *arg) {
+    struct inline_arg *a = (struct inline_arg *)arg;
+    // 参数在栈顶, 让出后依然有效
+    co_yield();
+    if (!co_canceled()) {
+        assert(a->tag[0] == 'a' + a->id % 26 && a->tag[99] == (char)a->id);
+        g_inline_sum += a->id;
+    }
+    g_inline_released++;
+}
+
+static int g_detach_waiting = 0, g_detach_release = 0, g_detach_woken = 0;
+static int g_sl_detached = 0;
+
+static void detach_target(void *arg) {
+    while (!g_detach_release) {
+        co_yield();
+    }
+}
+
+static void detach_waiter(void *arg) {
+    g_detach_waiting++;
+    co_wait((struct co *)arg);
+    g_detach_woken++;
+}
+
+// 被唤醒后不能再访问 target, 它已经随 detach 释放了
+static int sl_detach_waiter(int *pc, void *frame) {
+    struct co **target = (struct co **)frame;
+    CO_SL_BEGIN(pc);
+    g_detach_waiting++;
+    CO_SL_AWAIT(pc, *target);
+    g_detach_woken++;
+    CO_SL_END(pc);
+}
+
+static int sl_detached(int *pc, void *frame) {
+    CO_SL_BEGIN(pc);
+    CO_SL_YIELD(pc);
+    g_sl_detached++;
+    CO_SL_END(pc);
+}
+
+static void test_14() {
+    struct co *cos[100];
+    for (int i = 0; i < 100; i++) {
+        void *arg;
+        cos[i] = co_start_inline("inline", inline_work, sizeof(struct inline_arg), &arg);
+        assert(((uintptr_t)arg & 15) == 0);
+        struct inline_arg *a = (struct inline_arg *)arg;
+        a->id = i;
+        a->tag[0] = 'a' + i % 26;
+        a->tag[99] = (char)i;
+    }
+    // 还没运行就被取消的也会进入 func
+    co_cancel(cos[0]);
+    for (int i = 0; i < 50; i++) {
+        co_wait(cos[i]);
+        co_detach(cos[i]); // 已结束, 立即释放
+    }
+    for (int i = 50; i < 100; i++) {
+        co_detach(cos[i]); // 结束时自动释放
+    }
+    while (g_inline_released < 100) {
+        co_yield();
+    }
+    // 已经在等待的协程在目标结束时仍然会被唤醒
+    struct co *target = co_start("detach-target", detach_target, NULL);
+    struct co *waiter = co_start("detach-waiter", detach_waiter, target);
+    struct co *sl_waiter = co_start_sl("sl-detach-waiter", sl_detach_waiter, &target, sizeof(target));
+    while (g_detach_waiting < 2) {
+        co_yield();
+    }
+    co_detach(target);
+    g_detach_release = 1;
+    co_wait(waiter);
+    co_detach(waiter);
+    co_wait(sl_waiter);
+    co_detach(sl_waiter);
+    // 无栈协程: 前一半运行中 detach, 后一半结束后 detach
+    struct co *sls[100];
+    for (int i = 0; i < 100; i++) {
+        sls[i] = co_start_sl("sl-detached", sl_detached, NULL, 0);
+    }
+    for (int i = 0; i < 50; i++) {
+        co_detach(sls[i]);
+    }
+    for (int i = 50; i < 100; i++) {
+        co_wait(sls[i]);
+        co_detach(sls[i]);
+    }
+    while (g_sl_detached < 100) {
+        co_yield();
+    }
+    printf("inline: %d, released %d, waiters woken %d, stackless %d", g_inline_sum, g_inline_released,
+           g_detach_woken, g_sl_detached);
+    assert(g_inline_sum == 4950 && g_inline_released == 100 && g_detach_woken == 2 && g_sl_detached == 100);
+}
+
+enum exit_mode { EXIT_PLAIN, EXIT_ARENA, EXIT_ARENA_THREAD, EXIT_BATCH };
+
+static void exit_work(void *arg) {
+    printf("bye"); // 还在 stdio 缓冲区里, 要靠 exit 刷出去
+    if (arg) {
+        pthread_exit(NULL);
+    }
+    exit(42);
+}
+
+static void *exit_thread(void *arg) {
+    co_stack_arena(0, -1);
+    co_wait(co_start("exit", exit_work, (void *)1));
+    return NULL;
+}
+
+// 在子进程里让协程调用 exit / pthread_exit, 检查退出码和缓冲的输出
+static int exit_in_child(int mode) {
+    int fds[2];
+    assert(pipe(fds) == 0);
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(fds[1], 1);
+        setvbuf(stdout, NULL, _IOFBF, 4096);
+        if (mode == EXIT_PLAIN || mode == EXIT_ARENA) {
+            // split stack 下普通的栈也是 libgcc 管理的栈段
+            if (mode == EXIT_ARENA) {
+                co_stack_arena(0, -1);
+            }
+            co_wait(co_start("exit", exit_work, NULL));
+        } else if (mode == EXIT_ARENA_THREAD) {
+            pthread_t tid;
+            pthread_create(&tid, NULL, exit_thread, NULL);
+            pthread_join(tid, NULL);
+            exit(42);
+        } else if (mode == EXIT_BATCH) {
+            // 成员调用 exit 时, 整批的映射里有它自己的栈
+            struct co *cos[4];
+            void *args[4] = { NULL, NULL, NULL, NULL };
+            co_start_batch("exit", exit_work, args, 4, cos);
+            co_wait_batch(cos, 4);
+        }
+        _exit(1);
+    }
+    close(fds[1]);
+    char buf[16] = {0};
+    ssize_t len = 0, n;
+    while ((n = read(fds[0], buf + len, sizeof(buf) - 1 - len)) > 0) {
+        len += n;
+    }
+    close(fds[0]);
+    int status;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 42 && strcmp(buf, "bye") == 0;
+}
+
+static void test_15() {
+    int plain = exit_in_child(EXIT_PLAIN);
+    int arena = exit_in_child(EXIT_ARENA);
+    int thread = exit_in_child(EXIT_ARENA_THREAD);
+    int batch = exit_in_child(EXIT_BATCH);
+    printf("exit: plain %s, arena %s, thread %s, batch %s", plain ? "ok" : "failed",
+           arena ? "ok" : "failed", thread ? "ok" : "failed", batch ? "ok" : "failed");
+    assert(plain && arena && thread && batch);
+}
+
 int main() {
     setbuf(stdout, NULL);
 
@@ -127,6 +807,45 @@ int main() {
     printf("\n\nTest #2. Expect: (libco-){200, 201, 202, ..., 399}\n");
     test_2();
 
+    printf("\n\nTest #3. Expect: thread-{0, 1, 2, 3}: 2000\n");
+    test_3();
+
+    printf("\n\nTest #4. Expect: posted: 100, parked 1100\n");
+    test_4();
+
+    printf("\n\nTest #5. Expect: cleaned: 3 or 4\n");
+    test_5();
+
+    printf("\n\nTest #6. Expect: dtors: 4\n");
+    test_6();
+
+    printf("\n\nTest #7. Expect: prof samples: found, handler restored\n");
+    test_7();
+
+    printf("\n\nTest #8. Expect: arena: 4000\n");
+    test_8();
+
+    printf("\n\nTest #9. Expect: batch: 45\n");
+    test_9();
+
+    printf("\n\nTest #10. Expect: stackless: 3000\n");
+    test_10();
+
+    printf("\n\nTest #11. Expect: watchdog: slice found, wait found\n");
+    test_11();
+
+    printf("\n\nTest #12. Expect: region: 8\n");
+    test_12();
+
+    printf("\n\nTest #13. Expect: handoff: 2000/2000\n");
+    test_13();
+
+    printf("\n\nTest #14. Expect: inline: 4950, released 100, waiters woken 2, stackless 100\n");
+    test_14();
+
+    printf("\n\nTest #15. Expect: exit: plain ok, arena ok, thread ok, batch ok\n");
+    test_15();
+
     printf("\n\n");
 
     return 0;
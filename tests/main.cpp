@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <assert.h>
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+#include "co.hpp"
+
+static int g_live = 0; // 存活的 counted 对象, 用来检查捕获都被析构了
+
+struct counted {
+    counted() { g_live++; }
+    counted(const counted &) { g_live++; }
+    counted(counted &&) noexcept { g_live++; }
+    ~counted() { g_live--; }
+};
+
+static void test_1() {
+    int sum = 0;
+    {
+        std::vector<toyco::task> tasks;
+        for (int i = 0; i < 100; i++) {
+            std::string name = "co-" + std::to_string(i);
+            counted c;
+            // 小捕获放在栈顶, 大捕获走堆
+            if (i % 2) {
+                tasks.push_back(toyco::spawn([&sum, i, name, c] {
+                    toyco::yield();
+                    assert(name == "co-" + std::to_string(i));
+                    sum += i;
+                }));
+            } else {
+                std::array<char, 1024> big{};
+                big[0] = (char)i;
+                tasks.push_back(toyco::spawn([&sum, big, c] {
+                    toyco::yield();
+                    sum += big[0];
+                }));
+            }
+        }
+        // 还没运行就被取消, 捕获也要析构
+        tasks[3].cancel();
+        toyco::task moved = std::move(tasks[0]);
+        assert(!tasks[0].joinable() && moved.joinable());
+        tasks[1].join();
+        tasks[2].detach();
+    } // 其余的在析构时 join
+    while (g_live > 0) {
+        toyco::yield(); // 等 detach 的那个结束
+    }
+    printf("spawn: %d, live %d", sum, g_live);
+    assert(sum == 4950 - 3 && g_live == 0);
+}
+
+static void test_2() {
+    toyco::channel<std::unique_ptr<int>> ch(4);
+    long sum = 0;
+    int done = 0;
+    std::vector<toyco::task> tasks;
+    for (int p = 0; p < 4; p++) {
+        tasks.push_back(toyco::spawn([&ch, p] {
+            for (int i = 0; i < 250; i++) {
+                bool ok = ch.send(std::make_unique<int>(p * 250 + i));
+                assert(ok);
+            }
+        }));
+    }
+    for (int c = 0; c < 3; c++) {
+        tasks.push_back(toyco::spawn([&ch, &sum, &done] {
+            while (auto v = ch.recv()) {
+                sum += **v;
+            }
+            done++;
+        }));
+    }
+    for (int p = 0; p < 4; p++) {
+        tasks[p].join();
+    }
+    ch.close();
+    bool ok = ch.send(std::make_unique<int>(0));
+    assert(!ok);
+    tasks.clear();
+    printf("channel: %ld, consumers %d", sum, done);
+    assert(sum == 499500 && done == 3);
+}
+
+static void test_3() {
+    toyco::mutex m;
+    int inside = 0, count = 0;
+    {
+        std::vector<toyco::task> tasks;
+        for (int i = 0; i < 10; i++) {
+            tasks.push_back(toyco::spawn([&] {
+                for (int k = 0; k < 100; k++) {
+                    int ret = m.lock();
+                    assert(ret == 0);
+                    assert(inside == 0);
+                    inside++;
+                    toyco::yield(); // 持有锁时让出
+                    inside--;
+                    count++;
+                    m.unlock();
+                }
+            }));
+        }
+    }
+    assert(m.try_lock());
+    m.unlock();
+    printf("mutex: %d", count);
+    assert(count == 1000);
+}
+
+int main() {
+    setbuf(stdout, NULL);
+
+    printf("Test #1. Expect: spawn: 4947, live 0\n");
+    test_1();
+
+    printf("\n\nTest #2. Expect: channel: 499500, consumers 3\n");
+    test_2();
+
+    printf("\n\nTest #3. Expect: mutex: 1000\n");
+    test_3();
+
+    printf("\n\n");
+
+    return 0;
+}